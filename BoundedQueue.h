@@ -0,0 +1,155 @@
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+// Bounded lock-free multi-producer / multi-consumer ring buffer (D. Vyukov's
+// sequence-number scheme) connecting the stages of the makeTree pipeline.
+//
+// push() blocks while the queue is full (backpressure on the producer stage),
+// pop() blocks while it is empty until the producers are marked done. Both
+// back off from spinning to yield() to a short sleep. Queue-depth and stall
+// counters are kept with relaxed atomics and reported by printStats().
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+template <class T>
+class BoundedQueue {
+ public:
+   // capacity is rounded up to a power of two
+   explicit BoundedQueue(size_t capacity)
+   {
+      size_t n = 2;
+      while (n < capacity)
+         n <<= 1;
+      fMask = n - 1;
+      fCells.reset(new Cell[n]);
+      for (size_t i = 0; i < n; ++i)
+         fCells[i].seq.store(i, std::memory_order_relaxed);
+   }
+
+   size_t capacity() const { return fMask + 1; }
+   size_t depth() const
+   {
+      return fEnqueuePos.load(std::memory_order_relaxed) - fDequeuePos.load(std::memory_order_relaxed);
+   }
+
+   bool tryPush(T &v)
+   {
+      Cell *cell;
+      size_t pos = fEnqueuePos.load(std::memory_order_relaxed);
+      for (;;) {
+         cell = &fCells[pos & fMask];
+         const size_t seq = cell->seq.load(std::memory_order_acquire);
+         const intptr_t dif = intptr_t(seq) - intptr_t(pos);
+         if (dif == 0) {
+            if (fEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               break;
+         } else if (dif < 0) {
+            return false; // full
+         } else {
+            pos = fEnqueuePos.load(std::memory_order_relaxed);
+         }
+      }
+      cell->data = std::move(v);
+      cell->seq.store(pos + 1, std::memory_order_release);
+      return true;
+   }
+
+   bool tryPop(T &v)
+   {
+      Cell *cell;
+      size_t pos = fDequeuePos.load(std::memory_order_relaxed);
+      for (;;) {
+         cell = &fCells[pos & fMask];
+         const size_t seq = cell->seq.load(std::memory_order_acquire);
+         const intptr_t dif = intptr_t(seq) - intptr_t(pos + 1);
+         if (dif == 0) {
+            if (fDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+               break;
+         } else if (dif < 0) {
+            return false; // empty
+         } else {
+            pos = fDequeuePos.load(std::memory_order_relaxed);
+         }
+      }
+      v = std::move(cell->data);
+      cell->seq.store(pos + fMask + 1, std::memory_order_release);
+      return true;
+   }
+
+   void push(T &v)
+   {
+      const size_t d = depth();
+      fDepthSum.fetch_add(d, std::memory_order_relaxed);
+      fPushes.fetch_add(1, std::memory_order_relaxed);
+      size_t maxDepth = fMaxDepth.load(std::memory_order_relaxed);
+      while (d > maxDepth && !fMaxDepth.compare_exchange_weak(maxDepth, d, std::memory_order_relaxed)) {
+      }
+
+      if (tryPush(v))
+         return;
+      fPushStalls.fetch_add(1, std::memory_order_relaxed);
+      for (int spin = 0; !tryPush(v); ++spin)
+         backoff(spin);
+   }
+
+   // false once the queue is empty and producersDone is set
+   bool pop(T &v, const std::atomic<bool> &producersDone)
+   {
+      if (tryPop(v))
+         return true;
+      fPopStalls.fetch_add(1, std::memory_order_relaxed);
+      for (int spin = 0;; ++spin) {
+         if (tryPop(v))
+            return true;
+         if (producersDone.load(std::memory_order_acquire))
+            return tryPop(v);
+         backoff(spin);
+      }
+   }
+
+   void printStats(const std::string &name, std::ostream &os = std::cout) const
+   {
+      const double n = fPushes.load();
+      os << "[pipeline] queue " << std::left << std::setw(14) << name << std::right << " capacity " << capacity()
+         << ", mean depth " << (n > 0 ? fDepthSum.load() / n : 0.) << ", max depth " << fMaxDepth.load()
+         << ", full stalls " << fPushStalls.load() << ", empty stalls " << fPopStalls.load() << " / "
+         << fPushes.load() << " items\n";
+   }
+
+ private:
+   struct Cell {
+      std::atomic<size_t> seq;
+      T data;
+   };
+
+   static void backoff(int spin)
+   {
+      if (spin < 64)
+         return;
+      if (spin < 128)
+         std::this_thread::yield();
+      else
+         std::this_thread::sleep_for(std::chrono::microseconds(50));
+   }
+
+   std::unique_ptr<Cell[]> fCells;
+   size_t fMask = 0;
+   alignas(64) std::atomic<size_t> fEnqueuePos{0};
+   alignas(64) std::atomic<size_t> fDequeuePos{0};
+
+   alignas(64) std::atomic<size_t> fPushes{0};
+   std::atomic<size_t> fDepthSum{0};
+   std::atomic<size_t> fMaxDepth{0};
+   std::atomic<size_t> fPushStalls{0};
+   std::atomic<size_t> fPopStalls{0};
+};
+
+#endif
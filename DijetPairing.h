@@ -0,0 +1,128 @@
+#ifndef DIJET_PAIRING_H
+#define DIJET_PAIRING_H
+
+// Greedy back-to-back pairing of the jets of one event.
+//
+// Candidates are all pairs with |dphi| >= dPhiMin, ordered by closeness
+// (pi - |dphi|), then by lead and sub index, so ties resolve the same way on
+// every platform. Pairs are accepted in that order if neither jet is used yet.
+// Partners of a jet lie within pi - dPhiMin of its opposite direction, so jets
+// are bucketed in phi (counting sort, bins at least that wide) and only the
+// <= 3 bins around the opposite direction are scanned; for a handful of jets
+// all pairs are tried instead. All buffers are reused between events.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+class DijetPairing {
+ public:
+   struct Pair {
+      int lead, sub;    // indices in the jet container
+      double closeness; // pi - |dphi|, smaller is closer to back-to-back
+   };
+
+   // below this many jets, scanning all pairs is cheaper than binning
+   static const int kMinBinnedJets = 16;
+
+   // jets: anything with pt() and phi() (any phi range). The returned pairs are valid until the next call.
+   template <class JetContainer>
+   const std::vector<Pair> &pair(const JetContainer &jets, double dPhiMin)
+   {
+      const int n = jets.size();
+      fPt.resize(n);
+      fPhi.resize(n);
+      for (int i = 0; i < n; ++i) {
+         fPt[i] = jets[i].pt();
+         fPhi[i] = wrap(jets[i].phi());
+      }
+
+      fCandidates.clear();
+      const double window = M_PI - dPhiMin + 1e-9; // margin, the cut itself is applied exactly
+      const int nBins = window > 0 ? int(2 * M_PI / window) : 0;
+      if (n < kMinBinnedJets || nBins < 4) {
+         for (int i = 0; i < n; ++i)
+            for (int j = i + 1; j < n; ++j)
+               addCandidate(i, j, dPhiMin);
+      } else {
+         binJets(nBins);
+         for (int i = 0; i < n; ++i) {
+            const int first = bin(fPhi[i] + M_PI - window, nBins);
+            for (int k = 0; k < 3; ++k) {
+               const int b = (first + k) % nBins;
+               for (int s = fBinStart[b]; s < fBinStart[b + 1]; ++s) {
+                  if (fSorted[s] > i)
+                     addCandidate(i, fSorted[s], dPhiMin);
+               }
+            }
+         }
+      }
+
+      std::sort(fCandidates.begin(), fCandidates.end(), [](const Pair &a, const Pair &b) {
+         if (a.closeness != b.closeness)
+            return a.closeness < b.closeness;
+         if (a.lead != b.lead)
+            return a.lead < b.lead;
+         return a.sub < b.sub;
+      });
+
+      fUsed.assign(n, 0);
+      fChosen.clear();
+      for (const Pair &p : fCandidates) {
+         if (!fUsed[p.lead] && !fUsed[p.sub]) {
+            fChosen.push_back(p);
+            fUsed[p.lead] = fUsed[p.sub] = 1;
+         }
+      }
+      return fChosen;
+   }
+
+   // number of candidate pairs of the last call
+   size_t nCandidates() const { return fCandidates.size(); }
+
+ private:
+   static double wrap(double phi)
+   {
+      phi = std::fmod(phi, 2 * M_PI);
+      return phi < 0 ? phi + 2 * M_PI : phi;
+   }
+   static int bin(double phi, int nBins) { return std::min(nBins - 1, int(wrap(phi) / (2 * M_PI) * nBins)); }
+
+   void addCandidate(int i, int j, double dPhiMin)
+   {
+      double dphi = std::abs(fPhi[i] - fPhi[j]);
+      if (dphi > M_PI)
+         dphi = 2 * M_PI - dphi;
+      if (dphi < dPhiMin)
+         return;
+      // leading jet first
+      if (fPt[j] > fPt[i])
+         std::swap(i, j);
+      fCandidates.push_back({i, j, M_PI - dphi});
+   }
+
+   // counting sort of the jet indices by phi bin; window <= bin width, so 3 bins cover it
+   void binJets(int nBins)
+   {
+      const int n = fPhi.size();
+      fBinOf.resize(n);
+      fBinStart.assign(nBins + 1, 0);
+      for (int i = 0; i < n; ++i) {
+         fBinOf[i] = bin(fPhi[i], nBins);
+         ++fBinStart[fBinOf[i] + 1];
+      }
+      for (int b = 0; b < nBins; ++b)
+         fBinStart[b + 1] += fBinStart[b];
+      fFill.assign(fBinStart.begin(), fBinStart.end() - 1);
+      fSorted.resize(n);
+      for (int i = 0; i < n; ++i)
+         fSorted[fFill[fBinOf[i]]++] = i;
+   }
+
+   std::vector<double> fPt, fPhi;
+   std::vector<int> fBinOf, fBinStart, fFill, fSorted;
+   std::vector<Pair> fCandidates, fChosen;
+   std::vector<char> fUsed;
+};
+
+#endif
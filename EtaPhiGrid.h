@@ -0,0 +1,132 @@
+#ifndef ETA_PHI_GRID_H
+#define ETA_PHI_GRID_H
+
+// Uniform eta-phi grid over the particles (or jets) of one event, for cone
+// counting and nearest-neighbour matching.
+//
+// Cells are at least R wide in eta and phi, so a cone of radius R only touches
+// the 3x3 cells around its centre: a query costs O(particles near the cone)
+// instead of O(N), which matters once pileup brings N to thousands. Particles
+// are bucketed with a counting sort into flat arrays that are reused between
+// events.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+class EtaPhiGrid {
+ public:
+   // Index the particles with pt >= partPtMin and |eta| <= partEtaMax for cones of radius R.
+   template <class PartContainer>
+   void build(const PartContainer &parts, double R, double partPtMin, double partEtaMax)
+   {
+      fR = R;
+      fEtaMax = partEtaMax;
+      fNEta = std::max(1, int(2 * partEtaMax / R));
+      fNPhi = std::max(3, int(2 * M_PI / R)); // >= 3, so the 3 phi neighbours are distinct
+      fCellEta = 2 * partEtaMax / fNEta;
+      fCellPhi = 2 * M_PI / fNPhi;
+
+      const int nCells = fNEta * fNPhi;
+      fCellStart.assign(nCells + 1, 0);
+      fCellOf.resize(parts.size());
+      fPartEta.resize(parts.size());
+      fPartPhi.resize(parts.size());
+      size_t i = 0;
+      for (const auto &p : parts) {
+         fCellOf[i] = -1;
+         const double eta = p.eta();
+         if (p.pt() >= partPtMin && std::abs(eta) <= partEtaMax) {
+            const double phi = p.phi(); // [0, 2pi)
+            fPartEta[i] = eta;
+            fPartPhi[i] = phi;
+            fCellOf[i] = cell(etaBin(eta), phiBin(phi));
+            ++fCellStart[fCellOf[i] + 1];
+         }
+         ++i;
+      }
+      for (int c = 0; c < nCells; ++c)
+         fCellStart[c + 1] += fCellStart[c];
+
+      fEta.resize(fCellStart[nCells]);
+      fPhi.resize(fCellStart[nCells]);
+      fIndex.resize(fCellStart[nCells]);
+      fFill.assign(fCellStart.begin(), fCellStart.end() - 1);
+      for (size_t k = 0; k < fCellOf.size(); ++k) {
+         if (fCellOf[k] < 0)
+            continue;
+         const int slot = fFill[fCellOf[k]]++;
+         fEta[slot] = fPartEta[k];
+         fPhi[slot] = fPartPhi[k];
+         fIndex[slot] = k;
+      }
+   }
+
+   // Same result as counting the indexed particles with deltaR < R; 0 if the cone is not fully inside.
+   int countInCone(double eta0, double phi0) const
+   {
+      if (std::abs(eta0) > fEtaMax - fR)
+         return 0; // require cone fully inside
+      int n = 0;
+      forEachInCone(eta0, phi0, [&](int, double) { ++n; });
+      return n;
+   }
+
+   // Index (in the container given to build()) of the closest indexed entry with deltaR < R, -1 if none.
+   int nearest(double eta0, double phi0) const
+   {
+      int best = -1;
+      double bestDR2 = fR * fR;
+      forEachInCone(eta0, phi0, [&](int index, double dR2) {
+         if (dR2 < bestDR2) {
+            bestDR2 = dR2;
+            best = index;
+         }
+      });
+      return best;
+   }
+
+ private:
+   // f(index, deltaR^2) for every indexed entry with deltaR < R
+   template <class F>
+   void forEachInCone(double eta0, double phi0, F &&f) const
+   {
+      if (fNEta == 0)
+         return;
+      phi0 = wrap(phi0);
+      const int ie0 = etaBin(eta0), ip0 = phiBin(phi0);
+      const double R2 = fR * fR;
+      for (int ie = std::max(0, ie0 - 1); ie <= std::min(fNEta - 1, ie0 + 1); ++ie) {
+         for (int dp = -1; dp <= 1; ++dp) {
+            const int c = cell(ie, (ip0 + dp + fNPhi) % fNPhi);
+            for (int k = fCellStart[c]; k < fCellStart[c + 1]; ++k) {
+               const double deta = fEta[k] - eta0;
+               double dphi = std::abs(fPhi[k] - phi0);
+               if (dphi > M_PI)
+                  dphi = 2 * M_PI - dphi;
+               const double dR2 = deta * deta + dphi * dphi;
+               if (dR2 < R2)
+                  f(fIndex[k], dR2);
+            }
+         }
+      }
+   }
+
+   static double wrap(double phi)
+   {
+      phi = std::fmod(phi, 2 * M_PI);
+      return phi < 0 ? phi + 2 * M_PI : phi;
+   }
+   int etaBin(double eta) const { return std::min(fNEta - 1, std::max(0, int((eta + fEtaMax) / fCellEta))); }
+   int phiBin(double phi) const { return std::min(fNPhi - 1, std::max(0, int(phi / fCellPhi))); }
+   int cell(int ie, int ip) const { return ie * fNPhi + ip; }
+
+   double fR = 0, fEtaMax = 0, fCellEta = 0, fCellPhi = 0;
+   int fNEta = 0, fNPhi = 0;
+   std::vector<int> fCellStart, fFill, fCellOf;
+   std::vector<double> fPartEta, fPartPhi; // per input particle, scratch
+   std::vector<double> fEta, fPhi;         // sorted by cell
+   std::vector<int> fIndex;                // input index, sorted by cell
+};
+
+#endif
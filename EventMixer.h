@@ -0,0 +1,77 @@
+#ifndef EVENT_MIXER_H
+#define EVENT_MIXER_H
+
+// Event-mixing pool for an uncorrelated baseline of COV(UE_A, UE_B).
+//
+// Dijets are classified by lead-jet pT and event multiplicity. Every class
+// keeps a ring buffer of the cone-B multiplicities (with their event id) of
+// its most recent `capacity` dijets; a new dijet's cone A is paired with cone
+// B of up to `depth` earlier dijets of the same class before its own cone B is
+// stored. Entries of the same generated event (other dijets, re-hadronized
+// copies) are skipped, they share its parton level. All ring buffers live in
+// one flat array (class-major), so the pool has a fixed size of
+// nClasses * capacity entries and a lookup touches one contiguous slice.
+
+#include <algorithm>
+#include <vector>
+
+class EventMixer {
+ public:
+   // ptEdges / multEdges: lower class edges; values beyond the last edge go into the last class
+   EventMixer(const std::vector<double> &ptEdges, const std::vector<double> &multEdges, int capacity, int depth)
+      : fPtEdges(ptEdges), fMultEdges(multEdges), fCapacity(capacity), fDepth(std::min(depth, capacity))
+   {
+      const size_t nClasses = fPtEdges.size() * fMultEdges.size();
+      fB.assign(nClasses * fCapacity, Entry());
+      fHead.assign(nClasses, 0);
+      fCount.assign(nClasses, 0);
+   }
+
+   int depth() const { return fDepth; }
+   size_t bytes() const { return fB.size() * sizeof(Entry); }
+
+   // Calls f(mixedB) for the (up to depth) most recent dijets of the same class from other events than eventId,
+   // then stores b. Returns the number of mixed pairs.
+   template <class F>
+   int mix(double leadPt, double mult, float b, long long eventId, F &&f)
+   {
+      const size_t c = classOf(leadPt, mult);
+      Entry *B = &fB[c * fCapacity];
+      int n = 0;
+      for (int k = 1; k <= fCount[c] && n < fDepth; ++k) {
+         const Entry &e = B[(fHead[c] - k + fCapacity) % fCapacity];
+         if (e.eventId == eventId)
+            continue;
+         f(e.b);
+         ++n;
+      }
+
+      B[fHead[c]] = {b, eventId};
+      fHead[c] = (fHead[c] + 1) % fCapacity;
+      fCount[c] = std::min(fCount[c] + 1, fCapacity);
+      return n;
+   }
+
+ private:
+   static size_t bin(const std::vector<double> &edges, double x)
+   {
+      const size_t i = std::upper_bound(edges.begin(), edges.end(), x) - edges.begin();
+      return i == 0 ? 0 : i - 1;
+   }
+   size_t classOf(double leadPt, double mult) const
+   {
+      return bin(fPtEdges, leadPt) * fMultEdges.size() + bin(fMultEdges, mult);
+   }
+
+   struct Entry {
+      float b = 0;
+      long long eventId = -1;
+   };
+
+   std::vector<double> fPtEdges, fMultEdges;
+   int fCapacity, fDepth;
+   std::vector<Entry> fB;          // [class][slot]
+   std::vector<int> fHead, fCount; // per class: next slot, filled slots
+};
+
+#endif
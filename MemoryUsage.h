@@ -0,0 +1,85 @@
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+// Memory of the current process as seen by Linux /proc, in kB (-1 if unavailable).
+//   VmRSS / VmHWM : resident set now / at its peak; pages shared copy-on-write
+//                   with a parent count fully in every process
+//   Pss           : proportional set size; shared pages are split between the
+//                   processes that map them, so summing over workers is meaningful
+//   heap          : bytes handed out by malloc (arenas + mmapped blocks), glibc >= 2.33 only
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace MemoryUsage {
+
+// value of a "Key:   1234 kB" line in a /proc file
+inline long readProcKb(const char *file, const char *key)
+{
+   FILE *f = std::fopen(file, "r");
+   if (!f)
+      return -1;
+   char line[256];
+   const size_t n = std::strlen(key);
+   long value = -1;
+   while (std::fgets(line, sizeof(line), f)) {
+      if (std::strncmp(line, key, n) == 0 && line[n] == ':') {
+         std::sscanf(line + n + 1, "%ld", &value);
+         break;
+      }
+   }
+   std::fclose(f);
+   return value;
+}
+
+inline long rssKb() { return readProcKb("/proc/self/status", "VmRSS"); }
+inline long peakRssKb() { return readProcKb("/proc/self/status", "VmHWM"); }
+inline long pssKb() { return readProcKb("/proc/self/smaps_rollup", "Pss"); }
+
+inline long heapKb()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+   const struct mallinfo2 mi = mallinfo2();
+   return long((mi.uordblks + mi.hblkhd) / 1024);
+#else
+   return -1;
+#endif
+}
+
+// RSS and heap at named checkpoints, in order of their first sample. A checkpoint
+// sampled repeatedly (e.g. inside the event loop) keeps the maximum of each.
+class Tracker {
+ public:
+   struct Checkpoint {
+      std::string label;
+      long rssKb, heapKb;
+   };
+
+   void sample(const std::string &label)
+   {
+      const long rss = rssKb(), heap = heapKb();
+      for (auto &c : fCheckpoints) {
+         if (c.label == label) {
+            c.rssKb = std::max(c.rssKb, rss);
+            c.heapKb = std::max(c.heapKb, heap);
+            return;
+         }
+      }
+      fCheckpoints.push_back({label, rss, heap});
+   }
+
+   const std::vector<Checkpoint> &checkpoints() const { return fCheckpoints; }
+
+ private:
+   std::vector<Checkpoint> fCheckpoints;
+};
+
+} // namespace MemoryUsage
+
+#endif
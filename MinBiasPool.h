@@ -0,0 +1,141 @@
+#ifndef MIN_BIAS_POOL_H
+#define MIN_BIAS_POOL_H
+
+// Pool of pre-generated minimum-bias track lists for pileup / embedding overlays.
+//
+// Each entry holds the selected tracks of one minimum-bias event (after the
+// track cuts and efficiency). overlay() adds Poisson(mu) entries to a signal
+// event, each rotated by a random angle in phi, so a pool of a few thousand
+// events can be reused for millions of signal events. The pool is stored as
+// flat arrays and can be saved to / loaded from a binary cache file; a key
+// computed from the generation settings detects stale caches.
+
+#include "fastjet/PseudoJet.hh"
+#include "TRandom.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+class MinBiasPool {
+ public:
+   // user_index of overlaid tracks: >= 0, so they count as charged constituents,
+   // and distinguishable from Pythia indices of the signal event
+   static const int kUserIndexOffset = 1 << 24;
+
+   size_t size() const { return fOffset.size() - 1; }
+   size_t nTracks() const { return fPx.size(); }
+   bool empty() const { return size() == 0; }
+
+   void clear()
+   {
+      fOffset.assign(1, 0);
+      fPx.clear();
+      fPy.clear();
+      fPz.clear();
+      fE.clear();
+   }
+
+   void add(const std::vector<fastjet::PseudoJet> &tracks)
+   {
+      for (const auto &p : tracks) {
+         fPx.push_back(p.px());
+         fPy.push_back(p.py());
+         fPz.push_back(p.pz());
+         fE.push_back(p.E());
+      }
+      fOffset.push_back(fPx.size());
+   }
+
+   // Append Poisson(mu) randomly chosen, randomly phi-rotated entries to parts; returns their number.
+   int overlay(TRandom &rng, double mu, std::vector<fastjet::PseudoJet> &parts) const
+   {
+      if (empty())
+         return 0;
+      const int n = rng.Poisson(mu);
+      for (int k = 0; k < n; ++k) {
+         const size_t entry = size_t(rng.Rndm() * size()) % size();
+         const double angle = 2 * M_PI * rng.Rndm();
+         const double c = std::cos(angle), s = std::sin(angle);
+         for (uint64_t i = fOffset[entry]; i < fOffset[entry + 1]; ++i) {
+            fastjet::PseudoJet pj(c * fPx[i] - s * fPy[i], s * fPx[i] + c * fPy[i], fPz[i], fE[i]);
+            pj.set_user_index(kUserIndexOffset + int(i - fOffset[entry]));
+            parts.push_back(pj);
+         }
+      }
+      return n;
+   }
+
+   bool save(const std::string &file, uint64_t key) const
+   {
+      const std::string tmp = file + ".tmp";
+      FILE *f = std::fopen(tmp.c_str(), "wb");
+      if (!f)
+         return false;
+      Header h;
+      std::memcpy(h.magic, "MBPOOL01", 8);
+      h.key = key;
+      h.nEntries = size();
+      h.nTracks = nTracks();
+      bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+      ok = ok && std::fwrite(fOffset.data(), sizeof(uint64_t), fOffset.size(), f) == fOffset.size();
+      for (const std::vector<float> *v : {&fPx, &fPy, &fPz, &fE})
+         ok = ok && std::fwrite(v->data(), sizeof(float), v->size(), f) == v->size();
+      ok = (std::fclose(f) == 0) && ok;
+      if (!ok || std::rename(tmp.c_str(), file.c_str()) != 0) {
+         std::remove(tmp.c_str());
+         return false;
+      }
+      return true;
+   }
+
+   // false if the file is missing, unreadable or was made with other settings
+   bool load(const std::string &file, uint64_t key)
+   {
+      FILE *f = std::fopen(file.c_str(), "rb");
+      if (!f)
+         return false;
+      Header h;
+      bool ok = std::fread(&h, sizeof(h), 1, f) == 1 && std::memcmp(h.magic, "MBPOOL01", 8) == 0 && h.key == key;
+      if (ok) {
+         fOffset.resize(h.nEntries + 1);
+         ok = std::fread(fOffset.data(), sizeof(uint64_t), fOffset.size(), f) == fOffset.size() &&
+              fOffset.back() == h.nTracks;
+         for (std::vector<float> *v : {&fPx, &fPy, &fPz, &fE}) {
+            v->resize(ok ? h.nTracks : 0);
+            ok = ok && std::fread(v->data(), sizeof(float), v->size(), f) == v->size();
+         }
+      }
+      std::fclose(f);
+      if (!ok)
+         clear();
+      return ok;
+   }
+
+   // FNV-1a of a settings string, used as cache key
+   static uint64_t key(const std::string &settings)
+   {
+      uint64_t h = 1469598103934665603ULL;
+      for (unsigned char c : settings) {
+         h ^= c;
+         h *= 1099511628211ULL;
+      }
+      return h;
+   }
+
+ private:
+   struct Header {
+      char magic[8];
+      uint64_t key;
+      uint64_t nEntries;
+      uint64_t nTracks;
+   };
+
+   std::vector<uint64_t> fOffset = {0}; // entry i is [fOffset[i], fOffset[i+1])
+   std::vector<float> fPx, fPy, fPz, fE;
+};
+
+#endif
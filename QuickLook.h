@@ -0,0 +1,203 @@
+#ifndef QUICK_LOOK_H
+#define QUICK_LOOK_H
+
+// Live quick-look histograms of a running makeTree job.
+//
+// The event loop fills a few fixed-bin arrays (lead pT, lead N_ch, closeness)
+// and counters. Every `interval` seconds update() copies them into a spare
+// buffer and wakes a background thread that writes the copy to
+// <output>.quicklook (binary QuickLookData, replaced atomically), so the loop
+// never waits for the file system. The time spent in the copies and in the
+// writer thread is reported as a fraction of the run time. The aggregator
+// anaTrees/quickLook.cpp merges the files of all running jobs.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+struct QuickLookData {
+   static const int kNLeadPt = 50; // 0 - 100 GeV/c
+   static const int kNLeadNch = 40; // 0 - 40
+   static const int kNCloseness = 40; // 0 - pi/4
+   static constexpr double kLeadPtMax = 100, kLeadNchMax = 40, kClosenessMax = M_PI / 4;
+
+   char magic[8];
+   int done; // 1 after the last snapshot of the job
+   double ptHatMin, ptHatMax;
+   double elapsed;      // s since the start of the event loop
+   double sigmaGen;     // mb, current estimate (0 if not known yet)
+   double costFraction; // snapshot cost / elapsed
+   long long events, accepted, pairs;
+   // per-pair weights (1 / hadron-level copies), bins 0 and n + 1 are under/overflow
+   double leadPt[kNLeadPt + 2];
+   double leadNch[kNLeadNch + 2];
+   double closeness[kNCloseness + 2];
+
+   static bool read(const char *file, QuickLookData &d)
+   {
+      FILE *f = std::fopen(file, "rb");
+      if (!f)
+         return false;
+      const bool ok = std::fread(&d, sizeof(d), 1, f) == 1 && std::memcmp(d.magic, "QLOOK001", 8) == 0;
+      std::fclose(f);
+      return ok;
+   }
+};
+
+class QuickLook {
+ public:
+   using Clock = std::chrono::steady_clock;
+
+   // interval <= 0: off, every call is a no-op
+   QuickLook(const std::string &file, double interval, double ptHatMin, double ptHatMax)
+      : fFile(file), fInterval(interval)
+   {
+      std::memset(&fData, 0, sizeof(fData));
+      std::memcpy(fData.magic, "QLOOK001", 8);
+      fData.ptHatMin = ptHatMin;
+      fData.ptHatMax = ptHatMax;
+      fStart = fLast = Clock::now();
+      if (fInterval > 0)
+         fWriter = std::thread([this]() { writeLoop(); });
+   }
+   QuickLook(const QuickLook &) = delete;
+   QuickLook &operator=(const QuickLook &) = delete;
+   ~QuickLook() { stopWriter(); }
+
+   void fillPair(double leadPt, double leadNch, double closeness, double w)
+   {
+      if (fInterval <= 0)
+         return;
+      ++fData.pairs;
+      fData.leadPt[bin(leadPt, QuickLookData::kNLeadPt, QuickLookData::kLeadPtMax)] += w;
+      fData.leadNch[bin(leadNch, QuickLookData::kNLeadNch, QuickLookData::kLeadNchMax)] += w;
+      fData.closeness[bin(closeness, QuickLookData::kNCloseness, QuickLookData::kClosenessMax)] += w;
+   }
+
+   // Call once per event with the run counters; publishes a snapshot every interval seconds.
+   void update(long long events, long long accepted, double sigmaGen)
+   {
+      if (fInterval <= 0 || (++fCalls & 63) != 0)
+         return; // look at the clock every 64 calls only
+      const Clock::time_point now = Clock::now();
+      if (seconds(fLast, now) >= fInterval) {
+         publish(events, accepted, sigmaGen, false);
+         fLast = now;
+      }
+   }
+
+   // Last snapshot (done = 1); waits for it to be written and prints the snapshot cost.
+   void finish(long long events, long long accepted, double sigmaGen)
+   {
+      if (fInterval <= 0)
+         return;
+      publish(events, accepted, sigmaGen, true);
+      stopWriter();
+      std::printf("[quicklook] %d snapshots to %s, cost %.3f s = %.4f%% of %.1f s (loop %.3f s, writer %.3f s)\n",
+                  fNSnapshots, fFile.c_str(), fPublishSeconds + fWriteSeconds, 100 * costFraction(),
+                  seconds(fStart, Clock::now()), fPublishSeconds, fWriteSeconds);
+   }
+
+ private:
+   static double seconds(Clock::time_point a, Clock::time_point b)
+   {
+      return std::chrono::duration<double>(b - a).count();
+   }
+   static int bin(double v, int n, double max)
+   {
+      if (v < 0)
+         return 0;
+      return v >= max ? n + 1 : 1 + std::min(n - 1, int(v / max * n));
+   }
+   double costFraction() const
+   {
+      const double elapsed = seconds(fStart, Clock::now());
+      return elapsed > 0 ? (fPublishSeconds + fWriteSeconds) / elapsed : 0;
+   }
+
+   void publish(long long events, long long accepted, double sigmaGen, bool done)
+   {
+      const Clock::time_point t0 = Clock::now();
+      fData.done = done;
+      fData.elapsed = seconds(fStart, t0);
+      fData.sigmaGen = sigmaGen;
+      fData.events = events;
+      fData.accepted = accepted;
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         fData.costFraction = costFraction();
+         fPending = fData; // the writer formats from its own copy
+         fHasPending = true;
+         ++fNSnapshots;
+      }
+      fWake.notify_one();
+      fPublishSeconds += seconds(t0, Clock::now());
+   }
+
+   void writeLoop()
+   {
+      QuickLookData copy;
+      for (;;) {
+         {
+            std::unique_lock<std::mutex> lock(fMutex);
+            fWake.wait(lock, [this]() { return fHasPending || fStop; });
+            if (!fHasPending)
+               return;
+            copy = fPending;
+            fHasPending = false;
+         }
+         const Clock::time_point t0 = Clock::now();
+         write(copy);
+         std::lock_guard<std::mutex> lock(fMutex);
+         fWriteSeconds += seconds(t0, Clock::now());
+      }
+   }
+
+   void write(const QuickLookData &d) const
+   {
+      const std::string tmp = fFile + ".tmp";
+      FILE *f = std::fopen(tmp.c_str(), "wb");
+      if (!f)
+         return;
+      const bool ok = std::fwrite(&d, sizeof(d), 1, f) == 1;
+      if ((std::fclose(f) == 0) && ok)
+         std::rename(tmp.c_str(), fFile.c_str());
+      else
+         std::remove(tmp.c_str());
+   }
+
+   void stopWriter()
+   {
+      if (!fWriter.joinable())
+         return;
+      {
+         std::lock_guard<std::mutex> lock(fMutex);
+         fStop = true;
+      }
+      fWake.notify_one();
+      fWriter.join();
+   }
+
+   std::string fFile;
+   double fInterval;
+   Clock::time_point fStart, fLast;
+   QuickLookData fData; // filled by the event loop
+
+   std::mutex fMutex; // guards fPending, fHasPending, fStop, fWriteSeconds
+   std::condition_variable fWake;
+   QuickLookData fPending;
+   bool fHasPending = false, fStop = false;
+   std::thread fWriter;
+
+   long long fCalls = 0;
+   int fNSnapshots = 0;
+   double fPublishSeconds = 0, fWriteSeconds = 0;
+};
+
+#endif
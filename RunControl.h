@@ -0,0 +1,193 @@
+#ifndef RUN_CONTROL_H
+#define RUN_CONTROL_H
+
+// Stop conditions and live progress reporting for the makeTree event loop.
+//
+// A run stops at the first of:
+//   - nEvents generated events (0 = no limit)
+//   - a wall-clock budget in seconds
+//   - a number of accepted dijet pairs
+//   - a relative statistical precision on the mean of one observable
+//   - SIGTERM / SIGINT (condor_rm), so the output is still finalised
+//   - the end of the input event file (endOfInput())
+//
+// Progress is written as key = value lines to a sidecar text file, replaced
+// atomically so it can be read at any time.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <string>
+
+namespace RunControlSignal {
+inline volatile std::sig_atomic_t &stopRequested()
+{
+   static volatile std::sig_atomic_t flag = 0;
+   return flag;
+}
+inline void handler(int) { stopRequested() = 1; }
+} // namespace RunControlSignal
+
+struct StopCriteria {
+   long long maxEvents = 0;       // generated events, 0 = unlimited
+   double maxSeconds = 0;         // wall-clock budget, 0 = unlimited
+   long long targetPairs = 0;     // accepted dijet pairs, 0 = unlimited
+   double targetPrecision = 0;    // relative error on the mean of the observable, 0 = off
+   std::string observable = "lead_n_charged";
+
+   bool bounded() const { return maxEvents > 0 || maxSeconds > 0 || targetPairs > 0 || targetPrecision > 0; }
+};
+
+class RunControl {
+ public:
+   using Clock = std::chrono::steady_clock;
+
+   RunControl(const StopCriteria &crit, const std::string &progressFile, double progressInterval)
+      : fCrit(crit), fProgressFile(progressFile), fProgressInterval(progressInterval)
+   {
+      std::signal(SIGTERM, RunControlSignal::handler);
+      std::signal(SIGINT, RunControlSignal::handler);
+      fStart = fLastProgress = Clock::now();
+   }
+
+   // Call once per generated event (before pythia.next()); returns false when the run should end.
+   bool next()
+   {
+      if (fEndOfInput)
+         return stop("endOfInput");
+      if (RunControlSignal::stopRequested())
+         return stop("signal");
+      if (fCrit.maxEvents > 0 && fEvents >= fCrit.maxEvents)
+         return stop("nEvents");
+      if (fCrit.targetPairs > 0 && fPairs >= fCrit.targetPairs)
+         return stop("targetPairs");
+      if (fCrit.targetPrecision > 0 && fPairs >= kMinPairsForPrecision && precision() <= fCrit.targetPrecision)
+         return stop("targetPrecision");
+
+      const Clock::time_point now = Clock::now();
+      const double elapsed = seconds(fStart, now);
+      if (fCrit.maxSeconds > 0 && elapsed >= fCrit.maxSeconds)
+         return stop("maxTime");
+      if (fProgressInterval > 0 && seconds(fLastProgress, now) >= fProgressInterval) {
+         writeProgress("running", elapsed);
+         fLastProgress = now;
+      }
+      ++fEvents;
+      return true;
+   }
+
+   void acceptEvent() { ++fAccepted; }
+
+   // The event of the last next() could not be read because the input is exhausted:
+   // it is not counted, and the next call to next() ends the run.
+   void endOfInput()
+   {
+      --fEvents;
+      fEndOfInput = true;
+   }
+
+   // One accepted dijet pair carrying the value of the precision observable.
+   void addPair(double value)
+   {
+      ++fPairs;
+      const double delta = value - fMean; // Welford running mean / variance
+      fMean += delta / fPairs;
+      fM2 += delta * (value - fMean);
+   }
+
+   // Relative statistical error on the mean of the observable.
+   double precision() const
+   {
+      if (fPairs < 2 || fMean == 0)
+         return INFINITY;
+      return std::sqrt(fM2 / (fPairs - 1) / fPairs) / std::abs(fMean);
+   }
+
+   void finish() { writeProgress("done", seconds(fStart, Clock::now())); }
+
+   long long events() const { return fEvents; }
+   long long accepted() const { return fAccepted; }
+   long long pairs() const { return fPairs; }
+   double elapsed() const { return seconds(fStart, Clock::now()); }
+   const std::string &stopReason() const { return fStopReason; }
+   const StopCriteria &criteria() const { return fCrit; }
+
+ private:
+   static const long long kMinPairsForPrecision = 100;
+
+   static double seconds(Clock::time_point a, Clock::time_point b)
+   {
+      return std::chrono::duration<double>(b - a).count();
+   }
+
+   bool stop(const char *reason)
+   {
+      if (fStopReason.empty())
+         fStopReason = reason;
+      return false;
+   }
+
+   // Estimated seconds until the first stop condition is reached, -1 if unknown.
+   double eta(double elapsed) const
+   {
+      if (fEvents == 0 || elapsed <= 0)
+         return -1;
+      const double rate = fEvents / elapsed; // events/s
+      double t = INFINITY;
+      if (fCrit.maxEvents > 0)
+         t = std::min(t, (fCrit.maxEvents - fEvents) / rate);
+      if (fCrit.maxSeconds > 0)
+         t = std::min(t, fCrit.maxSeconds - elapsed);
+      if (fPairs > 0) {
+         const double pairsPerEvent = double(fPairs) / fEvents;
+         if (fCrit.targetPairs > 0)
+            t = std::min(t, (fCrit.targetPairs - fPairs) / pairsPerEvent / rate);
+         // error scales as 1/sqrt(N)
+         if (fCrit.targetPrecision > 0 && std::isfinite(precision())) {
+            const double r = precision() / fCrit.targetPrecision;
+            t = std::min(t, std::max(0.0, fPairs * (r * r - 1)) / pairsPerEvent / rate);
+         }
+      }
+      return std::isfinite(t) ? std::max(0.0, t) : -1;
+   }
+
+   void writeProgress(const char *state, double elapsed) const
+   {
+      if (fProgressFile.empty())
+         return;
+      const std::string tmp = fProgressFile + ".tmp";
+      FILE *f = std::fopen(tmp.c_str(), "w");
+      if (!f)
+         return;
+      std::fprintf(f, "state = %s\n", state);
+      std::fprintf(f, "elapsed_s = %.1f\n", elapsed);
+      std::fprintf(f, "events = %lld\n", fEvents);
+      std::fprintf(f, "accepted = %lld\n", fAccepted);
+      std::fprintf(f, "pairs = %lld\n", fPairs);
+      std::fprintf(f, "events_per_s = %.2f\n", elapsed > 0 ? fEvents / elapsed : 0.);
+      std::fprintf(f, "acceptance = %.4f\n", fEvents > 0 ? double(fAccepted) / fEvents : 0.);
+      std::fprintf(f, "precision_%s = %.4g\n", fCrit.observable.c_str(), precision());
+      std::fprintf(f, "eta_s = %.0f\n", eta(elapsed));
+      if (!fStopReason.empty())
+         std::fprintf(f, "stop_reason = %s\n", fStopReason.c_str());
+      std::fclose(f);
+      std::rename(tmp.c_str(), fProgressFile.c_str());
+   }
+
+   StopCriteria fCrit;
+   std::string fProgressFile;
+   double fProgressInterval;
+   Clock::time_point fStart, fLastProgress;
+   std::string fStopReason;
+
+   long long fEvents = 0;
+   long long fAccepted = 0;
+   long long fPairs = 0;
+   double fMean = 0;
+   double fM2 = 0;
+   bool fEndOfInput = false;
+};
+
+#endif
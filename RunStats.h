@@ -0,0 +1,32 @@
+#ifndef RUN_STATS_H
+#define RUN_STATS_H
+
+// The "stats" histogram of a makeTree output, also written into the anaTrees
+// histogram caches: six labelled bins nEvents, nAccepted, ptHatMin, ptHatMax,
+// sigmaGen_mb (error: sigmaErr) and sigmaErr_mb. sigmaGen / nEvents is the
+// per-event weight.
+
+#include "TH1D.h"
+
+#include <vector>
+
+// booked in the current directory
+inline TH1D *makeStats(long long nEvents, long long nAccepted, double sigmaGen, double sigmaErr)
+{
+   TH1D *stats = new TH1D("stats", "stats", 6, 0, 6);
+   const std::vector<const char *> statNames = {"nEvents",  "nAccepted",   "ptHatMin",
+                                                "ptHatMax", "sigmaGen_mb", "sigmaErr_mb"};
+   for (size_t i = 0; i < statNames.size(); ++i)
+      stats->GetXaxis()->SetBinLabel(i + 1, statNames[i]);
+
+   stats->SetBinContent(1, nEvents);
+   stats->SetBinContent(2, nAccepted);
+   // stats->SetBinContent(3, ptHatMin);
+   // stats->SetBinContent(4, ptHatMax);
+   stats->SetBinContent(5, sigmaGen);
+   stats->SetBinError(5, sigmaErr);
+   // stats->SetBinContent(6, sigmaErr);
+   return stats;
+}
+
+#endif
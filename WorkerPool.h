@@ -0,0 +1,132 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+// Fork-after-init worker pool for makeTree.
+//
+// The parent runs pythia8.init() once and then forks N workers. Pythia's
+// settings and particle databases, PDF grids and the ROOT dictionaries stay
+// shared copy-on-write between the workers; each worker reseeds, generates its
+// share of events into its own shard file and sends a WorkerReport back
+// through a pipe before it exits. The parent waits for all of them and
+// forwards SIGTERM / SIGINT so every worker can still finalise its shard.
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "RunControl.h"
+
+struct WorkerReport {
+   int index = -1;
+   long peakRssKb = -1;       // VmHWM of the worker, shared pages included
+   long pssKb = -1;           // proportional set size at the end of the worker
+   double startupSeconds = 0; // fork -> ready to generate
+   double loopSeconds = 0;    // event loop
+   long long events = 0;
+};
+
+class WorkerPool {
+ public:
+   explicit WorkerPool(int nWorkers) : fN(nWorkers) {}
+
+   // Forks the workers. Returns the worker index (0..N-1) in a worker. In the
+   // parent it waits for every worker and returns -1; check ok() afterwards.
+   int fork()
+   {
+      if (pipe(fPipe) != 0) {
+         std::perror("[error] pipe");
+         return -1;
+      }
+      std::cout.flush();
+      std::cerr.flush();
+      std::fflush(nullptr);
+
+      for (int i = 0; i < fN; ++i) {
+         const pid_t pid = ::fork();
+         if (pid < 0) {
+            std::perror("[error] fork");
+            fFailed = true;
+            break;
+         }
+         if (pid == 0) {
+            ::close(fPipe[0]);
+            fIndex = i;
+            return i;
+         }
+         fPids.push_back(pid);
+      }
+      ::close(fPipe[1]);
+      wait();
+      return -1;
+   }
+
+   // Worker side: hand the report to the parent.
+   void report(const WorkerReport &r)
+   {
+      if (fIndex < 0)
+         return;
+      if (::write(fPipe[1], &r, sizeof(r)) != ssize_t(sizeof(r)))
+         std::perror("[error] worker report");
+      ::close(fPipe[1]);
+   }
+
+   bool ok() const { return !fFailed; }
+   int size() const { return fN; }
+   const std::vector<WorkerReport> &reports() const { return fReports; }
+
+ private:
+   void wait()
+   {
+      // no SA_RESTART: waitpid() must return on a signal so it can be forwarded
+      struct sigaction sa;
+      sa.sa_handler = RunControlSignal::handler;
+      sigemptyset(&sa.sa_mask);
+      sa.sa_flags = 0;
+      sigaction(SIGTERM, &sa, nullptr);
+      sigaction(SIGINT, &sa, nullptr);
+
+      size_t nRunning = fPids.size();
+      bool forwarded = false;
+      while (nRunning > 0) {
+         int status = 0;
+         const pid_t pid = waitpid(-1, &status, 0);
+         if (pid < 0) {
+            if (errno != EINTR)
+               break;
+            if (RunControlSignal::stopRequested() && !forwarded) {
+               for (pid_t p : fPids)
+                  kill(p, SIGTERM);
+               forwarded = true;
+            }
+            continue;
+         }
+         --nRunning;
+         if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::cerr << "[error] worker " << pid << " failed (status " << status << ")\n";
+            fFailed = true;
+         }
+      }
+
+      WorkerReport r;
+      while (::read(fPipe[0], &r, sizeof(r)) == ssize_t(sizeof(r)))
+         fReports.push_back(r);
+      ::close(fPipe[0]);
+      if (fReports.size() != size_t(fN))
+         fFailed = true;
+   }
+
+   int fN;
+   int fIndex = -1;
+   int fPipe[2] = {-1, -1};
+   bool fFailed = false;
+   std::vector<pid_t> fPids;
+   std::vector<WorkerReport> fReports;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#ifndef DIJET_SNAPSHOT_H
+#define DIJET_SNAPSHOT_H
+
+// Flat, memory-mapped columnar copy of one merged "events" tree.
+//
+// <input>.root  ->  <input>.snapshot
+//
+// The snapshot stores only the branches the analysis loops read, with the
+// per-bin weight (sigmaGen / nEvents from the "stats" histogram) already folded
+// into the weight column, times the per-entry "weight" branch if the tree has
+// one (1/K for re-hadronized copies). It is rebuilt only when the fingerprint of the input
+// file (size + mtime) changes, so repeated passes read plain arrays from the
+// page cache instead of decompressing ROOT baskets.
+
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1D.h"
+#include "TString.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class DijetSnapshot {
+ public:
+   static const uint32_t kVersion = 3; // bump when a column or its meaning changes
+
+   DijetSnapshot() = default;
+   DijetSnapshot(const DijetSnapshot &) = delete;
+   DijetSnapshot &operator=(const DijetSnapshot &) = delete;
+   DijetSnapshot(DijetSnapshot &&o) noexcept { *this = std::move(o); }
+   DijetSnapshot &operator=(DijetSnapshot &&o) noexcept
+   {
+      if (this != &o) {
+         unmap();
+         fBase = o.fBase;
+         fSize = o.fSize;
+         fHeader = o.fHeader;
+         o.fBase = nullptr;
+         o.fSize = 0;
+         o.fHeader = nullptr;
+      }
+      return *this;
+   }
+   ~DijetSnapshot() { unmap(); }
+
+   // Map the snapshot belonging to rootFile, (re)building it first if it is
+   // missing or stale. Returns false if neither is possible.
+   bool open(const TString &rootFile)
+   {
+      unmap();
+      const TString path = snapshotPath(rootFile);
+      uint64_t fp = 0;
+      if (!fingerprint(rootFile, fp)) {
+         std::cerr << "Error: could not stat file " << rootFile << std::endl;
+         return false;
+      }
+      if (map(path, fp))
+         return true;
+      std::cout << "Building snapshot " << path << std::endl;
+      if (!build(rootFile, path, fp))
+         return false;
+      return map(path, fp);
+   }
+
+   Long64_t size() const { return fHeader ? fHeader->nEntries : 0; }
+   double nEvents() const { return fHeader->nEvents; }
+   double nAccepted() const { return fHeader->nAccepted; }
+   double xsec() const { return fHeader->xsec; } // mb
+
+   // pt and closeness stay double, so the cuts select exactly the same entries as on the tree
+   const double *lead_pt() const { return column<double>(kLeadPt); }
+   const double *sub_pt() const { return column<double>(kSubPt); }
+   const int32_t *lead_n_charged() const { return column<int32_t>(kLeadNch); }
+   const int32_t *sub_n_charged() const { return column<int32_t>(kSubNch); }
+   const double *closeness() const { return column<double>(kCloseness); }
+   const float *background_mult_A() const { return column<float>(kBackgroundA); }
+   const float *background_mult_B() const { return column<float>(kBackgroundB); }
+   const double *weight() const { return column<double>(kWeight); }
+
+   // FNV-1a over everything that invalidates the snapshot
+   static bool fingerprint(const TString &rootFile, uint64_t &fp)
+   {
+      struct stat st;
+      if (stat(rootFile.Data(), &st) != 0)
+         return false;
+      const uint64_t fields[] = {kVersion, uint64_t(st.st_size), uint64_t(st.st_mtim.tv_sec),
+                                 uint64_t(st.st_mtim.tv_nsec)};
+      fp = fnv1a(fields, sizeof(fields));
+      return true;
+   }
+
+   static uint64_t fnv1a(const void *data, size_t n, uint64_t h = 1469598103934665603ULL)
+   {
+      const unsigned char *bytes = static_cast<const unsigned char *>(data);
+      for (size_t i = 0; i < n; ++i) {
+         h ^= bytes[i];
+         h *= 1099511628211ULL;
+      }
+      return h;
+   }
+
+   // Creates a unique temporary file next to path (mkstemp, mode 0644) and returns its descriptor, -1 on failure.
+   // Concurrent writers of the same path each get their own name and only the final rename is shared.
+   static int createTemp(const TString &path, TString &tmp)
+   {
+      std::string name = std::string(path.Data()) + ".XXXXXX";
+      const int fd = mkstemp(&name[0]);
+      if (fd >= 0)
+         fchmod(fd, 0644);
+      tmp = name.c_str();
+      return fd;
+   }
+
+   static TString snapshotPath(const TString &rootFile)
+   {
+      TString path = rootFile;
+      if (path.EndsWith(".root"))
+         path = path(0, path.Length() - 5);
+      return path + ".snapshot";
+   }
+
+ private:
+   enum Column { kLeadPt, kSubPt, kLeadNch, kSubNch, kCloseness, kBackgroundA, kBackgroundB, kWeight, kNColumns };
+
+   struct Header {
+      char magic[8];
+      uint32_t version;
+      uint32_t nColumns;
+      uint64_t nEntries;
+      uint64_t fingerprint;
+      double nEvents;
+      double nAccepted;
+      double xsec;
+      uint64_t offset[kNColumns]; // byte offset of each column from the file start
+   };
+
+   static size_t columnWidth(int c)
+   {
+      return (c == kLeadPt || c == kSubPt || c == kCloseness || c == kWeight) ? sizeof(double) : 4;
+   }
+   static uint64_t align(uint64_t x) { return (x + 63) & ~uint64_t(63); } // cache-line aligned columns
+
+   template <class T>
+   const T *column(int c) const
+   {
+      return reinterpret_cast<const T *>(static_cast<const char *>(fBase) + fHeader->offset[c]);
+   }
+
+   bool map(const TString &path, uint64_t fp)
+   {
+      int fd = ::open(path.Data(), O_RDONLY);
+      if (fd < 0)
+         return false;
+      struct stat st;
+      if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(Header)) {
+         ::close(fd);
+         return false;
+      }
+      void *base = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      ::close(fd);
+      if (base == MAP_FAILED)
+         return false;
+
+      const Header *h = static_cast<const Header *>(base);
+      bool ok = std::memcmp(h->magic, "DIJETCOL", 8) == 0 && h->version == kVersion && h->nColumns == kNColumns &&
+                h->fingerprint == fp;
+      for (int c = 0; ok && c < kNColumns; ++c)
+         ok = h->offset[c] + h->nEntries * columnWidth(c) <= uint64_t(st.st_size);
+      if (!ok) {
+         munmap(base, st.st_size);
+         return false;
+      }
+      madvise(base, st.st_size, MADV_SEQUENTIAL);
+      fBase = base;
+      fSize = st.st_size;
+      fHeader = h;
+      return true;
+   }
+
+   void unmap()
+   {
+      if (fBase)
+         munmap(fBase, fSize);
+      fBase = nullptr;
+      fSize = 0;
+      fHeader = nullptr;
+   }
+
+   static bool build(const TString &rootFile, const TString &path, uint64_t fp)
+   {
+      TDirectory::TContext context; // opening the input must not change gDirectory for the caller
+      std::unique_ptr<TFile> f(TFile::Open(rootFile));
+      if (!f || f->IsZombie()) {
+         std::cerr << "Error: could not open file " << rootFile << std::endl;
+         return false;
+      }
+      TH1D *stats = (TH1D *)f->Get("stats");
+      TTree *t = (TTree *)f->Get("events");
+      if (!stats || !t) {
+         std::cerr << "Error: stats histogram or events tree not found in file " << rootFile << std::endl;
+         return false;
+      }
+      if (!(stats->GetBinContent(1) > 0)) {
+         std::cerr << "Error: no generated events in the stats histogram of " << rootFile << std::endl;
+         return false;
+      }
+
+      Header h;
+      std::memset(&h, 0, sizeof(h));
+      std::memcpy(h.magic, "DIJETCOL", 8);
+      h.version = kVersion;
+      h.nColumns = kNColumns;
+      h.fingerprint = fp;
+      h.nEvents = stats->GetBinContent(1);
+      h.nAccepted = stats->GetBinContent(2);
+      h.xsec = stats->GetBinContent(5);
+      const double binWeight = h.xsec / h.nEvents;
+
+      int lead_n_charged, sub_n_charged;
+      double lead_pt, sub_pt, closeness, background_mult_A, background_mult_B;
+      double entryWeight = 1;
+      const bool hasWeight = t->GetBranch("weight") != nullptr;
+      t->SetBranchStatus("*", false);
+      const char *branches[] = {"lead_pt",   "sub_pt",           "lead_n_charged",   "sub_n_charged",
+                                "closeness", "background_mult_A", "background_mult_B"};
+      for (const char *b : branches)
+         t->SetBranchStatus(b, true);
+      t->SetBranchAddress("lead_pt", &lead_pt);
+      t->SetBranchAddress("sub_pt", &sub_pt);
+      t->SetBranchAddress("lead_n_charged", &lead_n_charged);
+      t->SetBranchAddress("sub_n_charged", &sub_n_charged);
+      t->SetBranchAddress("closeness", &closeness);
+      t->SetBranchAddress("background_mult_A", &background_mult_A);
+      t->SetBranchAddress("background_mult_B", &background_mult_B);
+      if (hasWeight) {
+         t->SetBranchStatus("weight", true);
+         t->SetBranchAddress("weight", &entryWeight);
+      }
+
+      const Long64_t n = t->GetEntries();
+      std::vector<double> cLeadPt(n), cSubPt(n), cCloseness(n), cWeight(n);
+      std::vector<float> cBackgroundA(n), cBackgroundB(n); // integer counts, exact as float
+      std::vector<int32_t> cLeadNch(n), cSubNch(n);
+      for (Long64_t i = 0; i < n; ++i) {
+         t->GetEntry(i);
+         cLeadPt[i] = lead_pt;
+         cSubPt[i] = sub_pt;
+         cLeadNch[i] = lead_n_charged;
+         cSubNch[i] = sub_n_charged;
+         cCloseness[i] = closeness;
+         cBackgroundA[i] = background_mult_A;
+         cBackgroundB[i] = background_mult_B;
+         cWeight[i] = binWeight * entryWeight;
+      }
+      f->Close();
+
+      h.nEntries = n;
+      const void *data[kNColumns] = {cLeadPt.data(),    cSubPt.data(),       cLeadNch.data(),     cSubNch.data(),
+                                     cCloseness.data(), cBackgroundA.data(), cBackgroundB.data(), cWeight.data()};
+      uint64_t offset = align(sizeof(Header));
+      for (int c = 0; c < kNColumns; ++c) {
+         h.offset[c] = offset;
+         offset = align(offset + n * columnWidth(c));
+      }
+
+      // write to a temporary name and rename, so a crashed build never leaves
+      // a half-written snapshot with a valid header behind
+      TString tmp;
+      const int fd = createTemp(path, tmp);
+      FILE *out = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+      if (!out) {
+         std::cerr << "Error: could not create snapshot " << tmp << std::endl;
+         if (fd >= 0) {
+            ::close(fd);
+            std::remove(tmp.Data());
+         }
+         return false;
+      }
+      static const char zeros[64] = {0};
+      bool ok = std::fwrite(&h, sizeof(h), 1, out) == 1;
+      uint64_t pos = sizeof(h);
+      for (int c = 0; ok && c < kNColumns; ++c) {
+         ok = std::fwrite(zeros, 1, h.offset[c] - pos, out) == h.offset[c] - pos;
+         ok = ok && std::fwrite(data[c], columnWidth(c), n, out) == size_t(n);
+         pos = h.offset[c] + n * columnWidth(c);
+      }
+      ok = (std::fclose(out) == 0) && ok;
+      if (!ok || std::rename(tmp.Data(), path.Data()) != 0) {
+         std::cerr << "Error: could not write snapshot " << path << std::endl;
+         std::remove(tmp.Data());
+         return false;
+      }
+      return true;
+   }
+
+   void *fBase = nullptr;
+   size_t fSize = 0;
+   const Header *fHeader = nullptr;
+};
+
+#endif
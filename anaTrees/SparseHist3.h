@@ -0,0 +1,271 @@
+#ifndef SPARSE_HIST3_H
+#define SPARSE_HIST3_H
+
+// Sparse weighted 3D histogram for the multiplicity correlations (x, y = N_ch,
+// z = pT slice).
+//
+// Only occupied (x, y) cells are stored: every z slice (under/overflow
+// included) is an open-addressing hash table of the packed cell index with the
+// sum of weights and of squared weights, so memory follows the number of
+// filled cells instead of nx * ny * nz. A slice can be iterated directly, which
+// is all the entropy/covariance needs; toTH3D() builds the equivalent TH3D
+// (same bins, errors and entries as filling a TH3D) only for output. Caches
+// keep the sparse form: writeCells() / readCells() store the occupied cells as
+// a small TTree.
+
+#include "TDirectory.h"
+#include "TH3D.h"
+#include "TList.h"
+#include "TParameter.h"
+#include "TTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class SparseHist3 {
+ public:
+   void book(const char *name, const char *title, int nx, double xmin, double xmax, int ny, double ymin, double ymax,
+             int nz, double zmin, double zmax)
+   {
+      fName = name;
+      fTitle = title;
+      fX = {nx, xmin, xmax};
+      fY = {ny, ymin, ymax};
+      fZ = {nz, zmin, zmax};
+      fSlices.assign(nz + 2, Slice());
+      fEntries = 0;
+   }
+
+   const char *GetName() const { return fName.c_str(); }
+   int nx() const { return fX.n; }
+   int ny() const { return fY.n; }
+   int nz() const { return fZ.n; }
+   double zMin() const { return fZ.min; }
+   double zMax() const { return fZ.max; }
+   double entries() const { return fEntries; }
+
+   // i-th ';'-separated field of the title (1 = x, 2 = y, 3 = z axis title), as TH1::SetTitle splits it
+   std::string axisTitle(int i) const
+   {
+      size_t begin = 0;
+      for (int k = 0; k < i && begin != std::string::npos; ++k) {
+         begin = fTitle.find(';', begin);
+         begin = begin == std::string::npos ? begin : begin + 1;
+      }
+      if (begin == std::string::npos)
+         return "";
+      return fTitle.substr(begin, fTitle.find(';', begin) - begin);
+   }
+
+   void fill(double x, double y, double z, double w)
+   {
+      ++fEntries;
+      Cell &c = fSlices[fZ.bin(z)].cell(key(fX.bin(x), fY.bin(y)));
+      c.sumw += w;
+      c.sumw2 += w * w;
+   }
+
+   void add(const SparseHist3 &o)
+   {
+      for (size_t iz = 0; iz < fSlices.size(); ++iz) {
+         for (const Cell &oc : o.fSlices[iz].cells) {
+            if (oc.key == 0)
+               continue;
+            Cell &c = fSlices[iz].cell(oc.key);
+            c.sumw += oc.sumw;
+            c.sumw2 += oc.sumw2;
+         }
+      }
+      fEntries += o.fEntries;
+   }
+
+   // same name, title and binning, empty
+   SparseHist3 emptyLike() const
+   {
+      SparseHist3 h;
+      h.book(fName.c_str(), fTitle.c_str(), fX.n, fX.min, fX.max, fY.n, fY.min, fY.max, fZ.n, fZ.min, fZ.max);
+      return h;
+   }
+
+   // The occupied cells as TTree <name> in the current directory: z bin, packed (x, y) cell, sumw, sumw2; the
+   // number of entries is the "entries" parameter of its user info.
+   void writeCells() const
+   {
+      TTree t(fName.c_str(), fTitle.c_str());
+      Int_t z;
+      UInt_t cell;
+      double sumw, sumw2;
+      t.Branch("z", &z, "z/I");
+      t.Branch("cell", &cell, "cell/i");
+      t.Branch("sumw", &sumw, "sumw/D");
+      t.Branch("sumw2", &sumw2, "sumw2/D");
+      for (z = 0; z < int(fSlices.size()); ++z) {
+         for (const Cell &c : fSlices[z].cells) {
+            if (c.key == 0)
+               continue;
+            cell = c.key;
+            sumw = c.sumw;
+            sumw2 = c.sumw2;
+            t.Fill();
+         }
+      }
+      t.GetUserInfo()->Add(new TParameter<double>("entries", fEntries));
+      t.Write();
+   }
+
+   // Adds the cells written by writeCells() (same binning) from dir. False if the tree is missing or a cell lies
+   // outside the binning; then the content is undefined, so read into an emptyLike() copy.
+   bool readCells(TDirectory *dir)
+   {
+      TTree *t = dynamic_cast<TTree *>(dir->Get(fName.c_str()));
+      if (!t)
+         return false;
+      Int_t z;
+      UInt_t cell;
+      double sumw, sumw2;
+      for (const char *b : {"z", "cell", "sumw", "sumw2"}) {
+         if (!t->GetBranch(b))
+            return false;
+      }
+      t->SetBranchAddress("z", &z);
+      t->SetBranchAddress("cell", &cell);
+      t->SetBranchAddress("sumw", &sumw);
+      t->SetBranchAddress("sumw2", &sumw2);
+      const UInt_t nCellKeys = UInt_t(fX.n + 2) * (fY.n + 2);
+      const Long64_t n = t->GetEntries();
+      for (Long64_t i = 0; i < n; ++i) {
+         t->GetEntry(i);
+         if (z < 0 || z >= int(fSlices.size()) || cell == 0 || cell > nCellKeys)
+            return false;
+         Cell &c = fSlices[z].cell(cell);
+         c.sumw += sumw;
+         c.sumw2 += sumw2;
+      }
+      TParameter<double> *entries = dynamic_cast<TParameter<double> *>(t->GetUserInfo()->FindObject("entries"));
+      fEntries += entries ? entries->GetVal() : 0;
+      return true;
+   }
+
+   // f(ix, iy, sumw, sumw2) for every occupied cell of z bin iz (0 and nz + 1: under/overflow), in no particular order
+   template <class F>
+   void forEachCell(int iz, F &&f) const
+   {
+      for (const Cell &c : fSlices[iz].cells) {
+         if (c.key != 0)
+            f(int((c.key - 1) % (fX.n + 2)), int((c.key - 1) / (fX.n + 2)), c.sumw, c.sumw2);
+      }
+   }
+
+   size_t nCells() const
+   {
+      size_t n = 0;
+      for (const Slice &s : fSlices)
+         n += s.used;
+      return n;
+   }
+   size_t bytes() const
+   {
+      size_t n = 0;
+      for (const Slice &s : fSlices)
+         n += s.cells.capacity() * sizeof(Cell);
+      return n;
+   }
+   // memory of the dense TH3D with Sumw2
+   size_t denseBytes() const { return size_t(fX.n + 2) * (fY.n + 2) * (fZ.n + 2) * 2 * sizeof(double); }
+
+   // dense copy, in the current directory
+   TH3D *toTH3D() const
+   {
+      TH3D *h = new TH3D(fName.c_str(), fTitle.c_str(), fX.n, fX.min, fX.max, fY.n, fY.min, fY.max, fZ.n, fZ.min,
+                         fZ.max);
+      if (h->GetSumw2N() == 0)
+         h->Sumw2();
+      for (int iz = 0; iz <= fZ.n + 1; ++iz) {
+         forEachCell(iz, [&](int ix, int iy, double sumw, double sumw2) {
+            const int bin = h->GetBin(ix, iy, iz);
+            h->SetBinContent(bin, sumw);
+            h->SetBinError(bin, std::sqrt(sumw2));
+         });
+      }
+      h->SetEntries(fEntries);
+      return h;
+   }
+
+ private:
+   struct Axis {
+      int n = 1;
+      double min = 0, max = 1;
+      // TAxis::FindBin for fixed bins: 0 underflow, n + 1 overflow
+      int bin(double v) const
+      {
+         if (v < min)
+            return 0;
+         if (v >= max)
+            return n + 1;
+         return 1 + std::min(n - 1, int(n * (v - min) / (max - min)));
+      }
+   };
+
+   struct Cell {
+      uint32_t key = 0; // 0 = empty slot
+      double sumw = 0, sumw2 = 0;
+   };
+
+   // open addressing with linear probing; capacity is a power of two, at most 3/4 full
+   struct Slice {
+      std::vector<Cell> cells;
+      size_t used = 0;
+
+      Cell &cell(uint32_t k)
+      {
+         if (4 * (used + 1) > 3 * cells.size())
+            grow();
+         const size_t mask = cells.size() - 1;
+         for (size_t i = hash(k) & mask;; i = (i + 1) & mask) {
+            if (cells[i].key == k)
+               return cells[i];
+            if (cells[i].key == 0) {
+               ++used;
+               cells[i].key = k;
+               return cells[i];
+            }
+         }
+      }
+
+      void grow()
+      {
+         std::vector<Cell> old;
+         old.swap(cells);
+         cells.assign(old.empty() ? 16 : 2 * old.size(), Cell());
+         const size_t mask = cells.size() - 1;
+         for (const Cell &c : old) {
+            if (c.key == 0)
+               continue;
+            size_t i = hash(c.key) & mask;
+            while (cells[i].key != 0)
+               i = (i + 1) & mask;
+            cells[i] = c;
+         }
+      }
+
+      // integer mixer, so that neighbouring cells spread over the low bits
+      static size_t hash(uint32_t k)
+      {
+         k = ((k >> 16) ^ k) * 0x45d9f3bu;
+         k = ((k >> 16) ^ k) * 0x45d9f3bu;
+         return (k >> 16) ^ k;
+      }
+   };
+
+   uint32_t key(int ix, int iy) const { return uint32_t(iy) * (fX.n + 2) + ix + 1; }
+
+   std::string fName, fTitle;
+   Axis fX, fY, fZ;
+   std::vector<Slice> fSlices; // [iz], 0 .. nz + 1
+   double fEntries = 0;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "TFile.h"
+#include "TTree.h"
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TH3D.h"
+#include "TStyle.h"
+#include <TMath.h>
+#include <iostream>
+
+#include "DijetSnapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+double getEntropy(TH1D *h)
+{
+   double entropy = 0;
+   int nBins = h->GetNbinsX();
+   double total = h->Integral();
+   for (int i = 1; i <= nBins; ++i) {
+      double p = h->GetBinContent(i) / total;
+      if (p > 0) {
+         entropy -= p * std::log(p);
+      }
+   }
+   return entropy;
+}
+
+double getEntropy(TH2D *h)
+{
+   double entropy = 0;
+   int nBinsX = h->GetNbinsX();
+   int nBinsY = h->GetNbinsY();
+   double total = h->Integral();
+   for (int i = 1; i <= nBinsX; ++i) {
+      for (int j = 1; j <= nBinsY; ++j) {
+         double p = h->GetBinContent(i, j) / total;
+         if (p > 0) {
+            entropy -= p * std::log(p);
+         }
+      }
+   }
+   return entropy;
+}
+
+double getCovariance(TH2D *h)
+{
+   double S1 = getEntropy((TH1D *)h->ProjectionX());
+   double S2 = getEntropy((TH1D *)h->ProjectionY());
+   double S12 = getEntropy(h);
+   return S1 + S2 - S12;
+}
+
+TH1D *getCovariance(TH3D *h, TString title = "")
+{
+   TString name = TString(h->GetName()) + "_cov";
+   TString z_title = h->GetZaxis()->GetTitle();
+   // strip off everything after ; in z_title
+   if (z_title.Index(";") >= 0)
+      z_title = z_title(0, z_title.Index(";"));
+
+   TH1D *cov = new TH1D(name, title + ";" + z_title + ";" + title, h->GetNbinsZ(), h->GetZaxis()->GetXmin(),
+                        h->GetZaxis()->GetXmax());
+   for (int i = 1; i <= h->GetNbinsZ(); ++i) {
+      h->GetZaxis()->SetRange(i, i);
+      TH2D *h2 = (TH2D *)h->Project3D("xy");
+      double c = getCovariance(h2);
+      cov->SetBinContent(i, c);
+      if (h2->GetEntries() != 0) {
+         double err = 1 / sqrt(h2->GetEntries());
+         cov->SetBinError(i, err);
+      }
+   }
+   return cov;
+}
+
+// covariance of everything with p_t^{lead} in z bins [zBin, nBinsZ]
+double getCovarianceAbove(TH3D *h, int zBin)
+{
+   h->GetZaxis()->SetRange(zBin, h->GetNbinsZ());
+   TH2D *h2 = (TH2D *)h->Project3D("xy");
+   double c = h2->Integral() > 0 ? getCovariance(h2) : 0;
+   h->GetZaxis()->SetRange(0, 0);
+   return c;
+}
+
+// Scan of the dijet balance cut p_t^{sublead}/p_t^{lead} > c and of a lower p_t^{lead} threshold in a single pass.
+// Every dijet is filled once, into the slice of the largest balance cut it still passes; summing the slices from the
+// top down afterwards gives the content of hMult3D / hBackgroundMultAVsMultBVsPt for every cut (cumulative binning).
+// Lead-pT thresholds are taken on the p_t^{lead} axis edges and integrated the same way.
+void anaCutScan()
+{
+   TH3::SetDefaultSumw2(true);
+   gStyle->SetOptStat(0);
+   TString prefix = "output/sum_pp200_ptHat_";
+   vector<TString> ptHatBins = {"2_3",   "3_4",   "4_5",   "5_7",   "7_9",   "9_11", "11_15",
+                                "15_20", "20_25", "25_35", "35_45", "45_55", "55_-1"};
+
+   // balance cut grid: balanceMin, balanceMin + balanceStep, ...
+   const int nBalanceCuts = 19;
+   const double balanceMin = 0.0;
+   const double balanceStep = 0.05;
+   // the cut values as typed for anaTrees (0.15, not 3 * 0.05), so the slices reproduce its balance < cut rejection
+   vector<double> balanceCuts(nBalanceCuts);
+   for (int k = 0; k < nBalanceCuts; ++k)
+      balanceCuts[k] = std::round(1e6 * (balanceMin + k * balanceStep)) / 1e6;
+
+   const int nPtBins = 20;
+   const double ptMin = 0;
+   const double ptMax = 100;
+
+   const int nMultBins = 30;
+   const double multMin = 0;
+   const double multMax = 30;
+
+   TFile *outFile = TFile::Open("anaCutScan.root", "RECREATE");
+   if (!outFile || outFile->IsZombie()) {
+      std::cerr << "Error: could not create output file anaCutScan.root" << std::endl;
+      return;
+   }
+
+   vector<TH3D *> hMult3D(nBalanceCuts), hBackgroundMultAVsMultBVsPt(nBalanceCuts);
+   for (int k = 0; k < nBalanceCuts; ++k) {
+      const double cut = balanceCuts[k];
+      TString tag = Form("_balance%02d", TMath::Nint(100 * cut));
+      hMult3D[k] = new TH3D("hMult3D" + tag,
+                            Form("Dijet multiplicity, p_{t}^{sublead}/p_{t}^{lead} > %.2f; N_{ch}^{lead};N_{ch}^{sublead};"
+                                 "p_{t}^{lead} (GeV/c); d#sigma/dN [mb]",
+                                 cut),
+                            nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+      hBackgroundMultAVsMultBVsPt[k] =
+         new TH3D("hBackgroundMultAVsMultBVsPt" + tag,
+                  Form("Background multiplicity, p_{t}^{sublead}/p_{t}^{lead} > %.2f; N_{ch}^{A};N_{ch}^{B};"
+                       "p_{t}^{lead} (GeV/c); d#sigma/dN [mb]",
+                       cut),
+                  nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+   }
+
+   for (const auto &bin : ptHatBins) {
+      TString fileName = prefix + bin + ".root";
+
+      DijetSnapshot snap;
+      if (!snap.open(fileName))
+         continue;
+
+      const double *lead_pt = snap.lead_pt();
+      const double *sub_pt = snap.sub_pt();
+      const int32_t *lead_n_charged = snap.lead_n_charged();
+      const int32_t *sub_n_charged = snap.sub_n_charged();
+      const float *background_mult_A = snap.background_mult_A();
+      const float *background_mult_B = snap.background_mult_B();
+      const double *weight = snap.weight(); // xsec / nEvents
+
+      const Long64_t nEntries = snap.size();
+      for (Long64_t i = 0; i < nEntries; ++i) {
+         double balance = sub_pt[i] / lead_pt[i];
+         // largest cut with balance >= cut, the same comparison as anaTrees
+         const int k = int(std::upper_bound(balanceCuts.begin(), balanceCuts.end(), balance) - balanceCuts.begin()) - 1;
+         if (k < 0)
+            continue;
+
+         hMult3D[k]->Fill(lead_n_charged[i], sub_n_charged[i], lead_pt[i], weight[i]);
+         hBackgroundMultAVsMultBVsPt[k]->Fill(background_mult_A[i], background_mult_B[i], lead_pt[i], weight[i]);
+      }
+   }
+   outFile->cd(); // the results below belong to the output file, whatever the inputs left in gDirectory
+
+   // cumulate slices: cut k contains every dijet with balance >= cut k
+   for (int k = nBalanceCuts - 2; k >= 0; --k) {
+      hMult3D[k]->Add(hMult3D[k + 1]);
+      hBackgroundMultAVsMultBVsPt[k]->Add(hBackgroundMultAVsMultBVsPt[k + 1]);
+   }
+
+   // grid of integrated covariances: x = balance cut, y = lower p_t^{lead} threshold
+   const double ptStep = (ptMax - ptMin) / nPtBins;
+   TH2D *hCovGrid = new TH2D("hCovGrid",
+                             "COV(N_{ch}^{lead},N_{ch}^{sublead}); p_{t}^{sublead}/p_{t}^{lead} cut; p_{t}^{lead} > "
+                             "(GeV/c)",
+                             nBalanceCuts, balanceMin - balanceStep / 2, balanceMin + (nBalanceCuts - 0.5) * balanceStep,
+                             nPtBins, ptMin - ptStep / 2, ptMax - ptStep / 2);
+   TH2D *hBackgroundCovGrid = (TH2D *)hCovGrid->Clone("hBackgroundCovGrid");
+   hBackgroundCovGrid->SetTitle("COV(UE_{A},UE_{B}); p_{t}^{sublead}/p_{t}^{lead} cut; p_{t}^{lead} > (GeV/c)");
+   TH2D *hSubtractedCovGrid = (TH2D *)hCovGrid->Clone("hSubtractedCovGrid");
+   hSubtractedCovGrid->SetTitle("COV(N_{ch}^{lead},N_{ch}^{sublead}) - COV(UE_{A},UE_{B}); "
+                                "p_{t}^{sublead}/p_{t}^{lead} cut; p_{t}^{lead} > (GeV/c)");
+
+   for (int k = 0; k < nBalanceCuts; ++k) {
+      // covariance curves vs p_t^{lead} for this cut
+      TH1D *covVsPt = getCovariance(hMult3D[k], "COV(N_{ch}^{lead},N_{ch}^{sublead})");
+      TH1D *backgroundCovVsPt = getCovariance(hBackgroundMultAVsMultBVsPt[k], "COV(UE_{A},UE_{B})");
+      TH1D *subtractedCovVsPt = (TH1D *)covVsPt->Clone(TString(hMult3D[k]->GetName()) + "_subtracted_cov");
+      subtractedCovVsPt->Add(backgroundCovVsPt, -1);
+      subtractedCovVsPt->SetTitle("COV(N_{ch}^{lead},N_{ch}^{sublead}) - COV(UE_{A},UE_{B})");
+
+      for (int j = 1; j <= nPtBins; ++j) {
+         double c = getCovarianceAbove(hMult3D[k], j);
+         double b = getCovarianceAbove(hBackgroundMultAVsMultBVsPt[k], j);
+         hCovGrid->SetBinContent(k + 1, j, c);
+         hBackgroundCovGrid->SetBinContent(k + 1, j, b);
+         hSubtractedCovGrid->SetBinContent(k + 1, j, c - b);
+      }
+   }
+
+   outFile->Write();
+   outFile->Close();
+}
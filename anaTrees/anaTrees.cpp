@@ -8,76 +8,69 @@
 #include "TLatex.h"
 #include "TLegend.h"
 #include "TStyle.h"
+#include "TNamed.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TROOT.h"
+#include "TSystem.h"
 #include <TColor.h>
 #include <iostream>
 
-#include <vector>
-
-static const double balanceCut = 0.2;
+#include "../RunStats.h"
+#include "DijetSnapshot.h"
+#include "SparseHist3.h"
 
-double getEntropy(TH1D *h)
-{
-   double entropy = 0;
-   int nBins = h->GetNbinsX();
-   double total = h->Integral();
-   for (int i = 1; i <= nBins; ++i) {
-      double p = h->GetBinContent(i) / total;
-      if (p > 0) {
-         entropy -= p * std::log(p);
-      }
-   }
-   return entropy;
-}
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
 
-double getEntropy(TH2D *h)
+// COV = S(x) + S(y) - S(x, y) (Shannon entropies) per z slice, straight from the occupied cells: the marginals include
+// the under/overflow of the other axis (as ProjectionX/Y of a projected TH2D), the error is 1/sqrt(effective entries).
+TH1D *getCovariance(const SparseHist3 &h, TString title = "")
 {
-   double entropy = 0;
-   int nBinsX = h->GetNbinsX();
-   int nBinsY = h->GetNbinsY();
-   double total = h->Integral();
-   for (int i = 1; i <= nBinsX; ++i) {
-      for (int j = 1; j <= nBinsY; ++j) {
-         double p = h->GetBinContent(i, j) / total;
-         if (p > 0) {
-            entropy -= p * std::log(p);
+   TString name = TString(h.GetName()) + "_cov";
+   TString z_title = h.axisTitle(3).c_str();
+   TH1D *cov = new TH1D(name, title + ";" + z_title + ";" + title, h.nz(), h.zMin(), h.zMax());
+   vector<double> px(h.nx() + 2), py(h.ny() + 2);
+   for (int iz = 1; iz <= h.nz(); ++iz) {
+      std::fill(px.begin(), px.end(), 0.);
+      std::fill(py.begin(), py.end(), 0.);
+      double total = 0, sumw = 0, sumw2 = 0; // in-range cells
+      h.forEachCell(iz, [&](int ix, int iy, double w, double w2) {
+         px[ix] += w;
+         py[iy] += w;
+         if (ix >= 1 && ix <= h.nx() && iy >= 1 && iy <= h.ny()) {
+            total += w;
+            sumw += w;
+            sumw2 += w2;
          }
-      }
-   }
-   return entropy;
-}
-
-double getCovariance(TH2D *h)
-{
-   double S1 = getEntropy((TH1D *)h->ProjectionX());
-   double S2 = getEntropy((TH1D *)h->ProjectionY());
-   double S12 = getEntropy(h);
-   return S1 + S2 - S12;
-}
-
-TH1D *getCovariance(TH3D *h, TString title = "")
-{
-   TString name = TString(h->GetName()) + "_cov";
-   TString z_title = h->GetZaxis()->GetTitle();
-   // strip off everything after ; in z_title
-   if (z_title.Index(";") >= 0)
-      z_title = z_title(0, z_title.Index(";"));
-
-   TH1D *cov = new TH1D(name, title + ";" + z_title + ";" + title, h->GetNbinsZ(), h->GetZaxis()->GetXmin(),
-                        h->GetZaxis()->GetXmax());
-   for (int i = 1; i <= h->GetNbinsZ(); ++i) {
-      h->GetZaxis()->SetRange(i, i);
-      TH2D *h2 = (TH2D *)h->Project3D("xy");
-      double c = getCovariance(h2);
-      cov->SetBinContent(i, c);
-      if (h2->GetEntries() != 0) {
-         double err = 1 / sqrt(h2->GetEntries());
-         cov->SetBinError(i, err);
-      }
+      });
+      double S12 = 0;
+      h.forEachCell(iz, [&](int ix, int iy, double w, double) {
+         const double p = w / total;
+         if (ix >= 1 && ix <= h.nx() && iy >= 1 && iy <= h.ny() && p > 0)
+            S12 -= p * std::log(p);
+      });
+      auto entropy = [](const vector<double> &m) {
+         double S = 0, sum = 0;
+         for (size_t i = 1; i + 1 < m.size(); ++i)
+            sum += m[i];
+         for (size_t i = 1; i + 1 < m.size(); ++i) {
+            const double p = m[i] / sum;
+            if (p > 0)
+               S -= p * std::log(p);
+         }
+         return S;
+      };
+      cov->SetBinContent(iz, entropy(px) + entropy(py) - S12);
+      if (sumw2 > 0)
+         cov->SetBinError(iz, 1 / sqrt(sumw * sumw / sumw2));
    }
    return cov;
 }
 
-void drawLabel(TPad *pad, float x = 0.57, TString extra = "")
+void drawLabel(TPad *pad, double balanceCut, float x = 0.57, TString extra = "")
 {
    pad->cd();
    TLatex *latex = new TLatex();
@@ -137,215 +130,486 @@ void drawProjectionsPt(TCanvas *can, TH2D *h)
 // pp200_pThat_15_20.root  pp200_pThat_25_35.root  pp200_pThat_45_55.root  pp200_pThat_5_7.root
 // pp200_pThat_20_25.root  pp200_pThat_3_4.root    pp200_pThat_4_5.root    pp200_pThat_7_9.root
 
-void anaTrees()
-{
-   TH1::SetDefaultSumw2(true); // proper errors when scaling
-   TH3::SetDefaultSumw2(true);
-   TH2::SetDefaultSumw2(true);
-   // only show n entries in stats
-   gStyle->SetOptStat(0);
-   TString prefix = "output/sum_pp200_ptHat_";
-   vector<TString> ptHatBins = {"2_3",   "3_4",   "4_5",   "5_7",   "7_9",   "9_11", "11_15",
-                                "15_20", "20_25", "25_35", "35_45", "45_55", "55_-1"};
-   // vector<TString> ptHatBins = {"2_3", "55_-1"};
+// Everything that changes the content of the analysis histograms. hash() keys
+// the per-file histogram cache, so a new cut or binning invalidates it.
+struct AnaConfig {
+   static const int kCacheVersion = 3; // bump when AnaHistograms::fill() or the cache format changes
+
+   double balanceCut = 0.2;
+   double leadPtMultCut = 70; // p_t^lead threshold of the N_ch distributions
+   int nPtBins = 20;
+   double ptMin = 0;
+   double ptMax = 100;
+   int nMultBins = 30;
+   double multMin = 0;
+   double multMax = 30;
+
+   uint64_t hash() const
+   {
+      TString s = Form("v%d %.17g %.17g %d %.17g %.17g %d %.17g %.17g", kCacheVersion, balanceCut, leadPtMultCut,
+                       nPtBins, ptMin, ptMax, nMultBins, multMin, multMax);
+      return DijetSnapshot::fnv1a(s.Data(), s.Length());
+   }
+};
+
+struct AnaHistograms {
+   TH1D *hMultLead, *hMultSublead;
+   TH2D *hMultLeadVsSub;
+   TH2D *hBackgroundAverageMult;
+   // multiplicity correlations: sparse, converted to TH3D only when written
+   SparseHist3 hMult3D, hMult3DLeSub;
+   SparseHist3 hBackgroundMultAVsMultBVsPt, hBackgroundMultAVsMultBVsLeSub;
+   SparseHist3 hMixedBackgroundMultAVsMultBVsPt; // cone A and cone B from different events
+   // QA histograms
+   TH1D *hPtLeSub, *hPtAll, *hPtLead, *hPtSub, *hBalance;
+   TH2D *hBalanceVsPt, *hBalanceVsLeSub;
+   TH1D *hCloseness;
+   TH2D *hClosenessVsPt, *hClosenessVsLeSub;
+
+   // books in the current directory
+   void book(const AnaConfig &c)
+   {
+      const int nPtBins = c.nPtBins, nMultBins = c.nMultBins;
+      const double ptMin = c.ptMin, ptMax = c.ptMax, multMin = c.multMin, multMax = c.multMax;
+
+      hMultLead = new TH1D("hMultLead", ";N_{ch}^{lead}", nMultBins, multMin, multMax);
+      hMultSublead = new TH1D("hMultSublead", ";N_{ch}^{sublead}", nMultBins, multMin, multMax);
+      hMultLeadVsSub =
+         new TH2D("hMultLeadVsSub", "Dijet multiplicity; N_{ch}^{lead};N_{ch}^{sublead}; d#sigma/dN [mb]", nMultBins,
+                  multMin, multMax, nMultBins, multMin, multMax);
+
+      hMult3D.book("hMult3D",
+                   "Dijet multiplicity; N_{ch}^{lead};N_{ch}^{sublead};p_{t}^{lead} (GeV/c); d#sigma/dN "
+                   "[mb]",
+                   nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+      hMult3DLeSub.book("hMult3DLeSub",
+                        "Dijet multiplicity; N_{ch}^{lead};N_{ch}^{sublead};p_{t}^{lead} - p_{t}^{sublead} (GeV/c);  "
+                        "d#sigma/dN [mb]",
+                        nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+
+      hBackgroundAverageMult =
+         new TH2D("hBackgroundAverageMult",
+                  "Background avg multiplicity; (N_{ch}^{A}+N_{ch}^{B})/2;p_{t}^{lead} (GeV/c); d#sigma/dN [mb]",
+                  nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+
+      hBackgroundMultAVsMultBVsPt.book(
+         "hBackgroundMultAVsMultBVsPt",
+         "Background multiplicity; N_{ch}^{A};N_{ch}^{B};p_{t}^{lead} (GeV/c); d#sigma/dN [mb]", nMultBins, multMin,
+         multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+
+      hMixedBackgroundMultAVsMultBVsPt.book(
+         "hMixedBackgroundMultAVsMultBVsPt",
+         "Mixed-event background multiplicity; N_{ch}^{A};N_{ch}^{B, mixed};p_{t}^{lead} (GeV/c); "
+         "d#sigma/dN [mb]",
+         nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+
+      hBackgroundMultAVsMultBVsLeSub.book(
+         "hBackgroundMultAVsMultBVsLeSub",
+         "Background multiplicity; N_{ch}^{A};N_{ch}^{B};p_{t}^{lead} - p_{t}^{sublead} (GeV/c); d#sigma/dN [mb]",
+         nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+
+      hPtLeSub = new TH1D("hPtLeSub",
+                          "p_{t}^{lead} - p_{t}^{sublead}; p_{t}^{lead} - p_{t}^{sublead} (GeV/c); "
+                          "d#sigma/dp_{t} [mb]",
+                          nPtBins, ptMin, ptMax);
+      hPtAll =
+         new TH1D("hPtAll", "All Jet p_{t}; p_{t} (GeV/c); d^{2}#sigma/(d#eta dp_{t}) [mb]", nPtBins, ptMin, ptMax);
+      hPtLead = new TH1D("hPtLead", "Leading Jet p_{t}; p_{t} (GeV/c); d^{2}#sigma/(d#eta dp_{t}) [mb]", nPtBins,
+                         ptMin, ptMax);
+      hPtSub = new TH1D("hPtSub", "Subleading Jet p_{t}; p_{t} (GeV/c); d^{2}#sigma/(d#eta dp_{t}) [mb]", nPtBins,
+                        ptMin, ptMax);
+      hBalance = new TH1D("hBalance", "p_{t}^{lead}/p_{t}^{sublead}; p_{t}^{lead}/p_{t}^{sublead}", 50, 0, 1);
+      hBalanceVsPt =
+         new TH2D("hBalanceVsPt",
+                  "p_{t}^{sublead}/p_{t}^{lead} vs p_{t}^{lead}; p_{t}^{lead} (GeV/c); p_{t}^{sublead}/p_{t}^{lead}",
+                  100, ptMin, ptMax, 50, 0, 1);
+      hBalanceVsLeSub = new TH2D(
+         "hBalanceVsLeSub",
+         "p_{t}^{sublead}/p_{t}^{lead} vs p_{t}^{lead} - p_{t}^{sublead}; p_{t}^{lead} - p_{t}^{sublead} (GeV/c); "
+         "p_{t}^{sublead}/p_{t}^{lead}",
+         100, ptMin, ptMax, 50, 0, 1);
+
+      hCloseness = new TH1D("hCloseness", "Closeness; |#phi_{lead} - #phi_{sublead} - #pi/2|", 50, 0, 1);
+      hClosenessVsPt = new TH2D(
+         "hClosenessVsPt", "Closeness vs p_{t}^{lead}; p_{t}^{lead} (GeV/c); |#phi_{lead} - #phi_{sublead}- #pi/2|",
+         100, ptMin, ptMax, 100, 0, 1);
+      hClosenessVsLeSub = new TH2D("hClosenessVsLeSub",
+                                   "Closeness vs p_{t}^{lead} - p_{t}^{sublead}; p_{t}^{lead} - p_{t}^{sublead} "
+                                   "(GeV/c); |#phi_{lead} - #phi_{sublead}- #pi/2|",
+                                   100, ptMin, ptMax, 100, 0, 1);
+   }
 
-   int lead_n_charged, sub_n_charged;
-   double lead_pt, sub_pt, lead_eta, sub_eta, lead_phi, sub_phi, closeness, background_mult_A, background_mult_B;
+   std::vector<TH1 *> all() const
+   {
+      return {hMultLead,
+              hMultSublead,
+              hMultLeadVsSub,
+              hBackgroundAverageMult,
+              hPtLeSub,
+              hPtAll,
+              hPtLead,
+              hPtSub,
+              hBalance,
+              hBalanceVsPt,
+              hBalanceVsLeSub,
+              hCloseness,
+              hClosenessVsPt,
+              hClosenessVsLeSub};
+   }
 
-   TFile *outFile = TFile::Open("anaTrees.root", "RECREATE");
-   if (!outFile || outFile->IsZombie()) {
-      std::cerr << "Error: could not create output file anaTrees.root" << std::endl;
-      return;
+   std::vector<SparseHist3 *> sparse()
+   {
+      return {&hMult3D, &hMult3DLeSub, &hBackgroundMultAVsMultBVsPt, &hMixedBackgroundMultAVsMultBVsPt,
+              &hBackgroundMultAVsMultBVsLeSub};
+   }
+   std::vector<const SparseHist3 *> sparse() const
+   {
+      return {&hMult3D, &hMult3DLeSub, &hBackgroundMultAVsMultBVsPt, &hMixedBackgroundMultAVsMultBVsPt,
+              &hBackgroundMultAVsMultBVsLeSub};
    }
-   // add text with jet parameters as latex to Histograms
 
-   TH1D *hStatistics = new TH1D("hStatistics", "nEvents; ptHat range;nEvents", ptHatBins.size(), 0, ptHatBins.size());
-   for (size_t i = 0; i < ptHatBins.size(); ++i) {
-      hStatistics->GetXaxis()->SetBinLabel(i + 1, ptHatBins[i]);
+   // adds the histograms of another partial
+   void add(const AnaHistograms &o)
+   {
+      const std::vector<TH1 *> mine = all(), theirs = o.all();
+      for (size_t i = 0; i < mine.size(); ++i)
+         mine[i]->Add(theirs[i]);
+      const std::vector<SparseHist3 *> mineSparse = sparse();
+      const std::vector<const SparseHist3 *> theirsSparse = o.sparse();
+      for (size_t i = 0; i < mineSparse.size(); ++i)
+         mineSparse[i]->add(*theirsSparse[i]);
    }
 
-   TH1D *hAcceptedEvents = (TH1D *)hStatistics->Clone("hAcceptedEvents");
-   hAcceptedEvents->SetTitle("nAcceptedEvents; ptHat range;nAcceptedEvents");
+   // writes all histograms to the current directory, the sparse ones as cell trees (cache format, see add(TDirectory*))
+   void write() const
+   {
+      for (TH1 *h : all())
+         h->Write();
+      for (const SparseHist3 *s : sparse())
+         s->writeCells();
+   }
 
-   const int nPtBins = 20;
-   const double ptMin = 0;
-   const double ptMax = 100;
-
-   const int nMultBins = 30;
-   const double multMin = 0;
-   const double multMax = 30;
-
-   TH1D *hMultLead = new TH1D("hMultLead", ";N_{ch}^{lead}", nMultBins, multMin, multMax);
-   TH1D *hMultSublead = new TH1D("hMultSublead", ";N_{ch}^{sublead}", nMultBins, multMin, multMax);
-   TH2D *hMultLeadVsSub =
-      new TH2D("hMultLeadVsSub", "Dijet multiplicity; N_{ch}^{lead};N_{ch}^{sublead}; d#sigma/dN [mb]", nMultBins,
-               multMin, multMax, nMultBins, multMin, multMax);
-
-   TH3D *hMult3D = new TH3D("hMult3D",
-                            "Dijet multiplicity; N_{ch}^{lead};N_{ch}^{sublead};p_{t}^{lead} (GeV/c); d#sigma/dN "
-                            "[mb]",
-                            nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
-   TH3D *hMult3DLeSub =
-      new TH3D("hMult3DLeSub",
-               "Dijet multiplicity; N_{ch}^{lead};N_{ch}^{sublead};p_{t}^{lead} - p_{t}^{sublead} (GeV/c);  d#sigma/dN "
-               "[mb]",
-               nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
-
-   TH2D *hBackgroundAverageMult =
-      new TH2D("hBackgroundAverageMult",
-               "Background avg multiplicity; (N_{ch}^{A}+N_{ch}^{B})/2;p_{t}^{lead} (GeV/c); d#sigma/dN [mb]",
-               nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
-
-   TH3D *hBackgroundMultAVsMultBVsPt =
-      new TH3D("hBackgroundMultAVsMultBVsPt",
-               "Background multiplicity; N_{ch}^{A};N_{ch}^{B};p_{t}^{lead} (GeV/c); d#sigma/dN [mb]", nMultBins,
-               multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
-
-   TH3D *hBackgroundMultAVsMultBVsLeSub =
-      new TH3D("hBackgroundMultAVsMultBVsLeSub",
-               "Background multiplicity; N_{ch}^{A};N_{ch}^{B};p_{t}^{lead} - p_{t}^{sublead} (GeV/c); d#sigma/dN [mb]",
-               nMultBins, multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
+   // the sparse histograms as TH3D, converted one at a time (final output)
+   void writeSparse() const
+   {
+      for (const SparseHist3 *s : sparse()) {
+         TH3D *h = s->toTH3D();
+         h->Write();
+         delete h;
+      }
+   }
 
-   // QA histograms
-   TH1D *hPtLeSub = new TH1D("hPtLeSub",
-                             "p_{t}^{lead} - p_{t}^{sublead}; p_{t}^{lead} - p_{t}^{sublead} (GeV/c); "
-                             "d#sigma/dp_{t} [mb]",
-                             nPtBins, ptMin, ptMax);
-   TH1D *hPtAll =
-      new TH1D("hPtAll", "All Jet p_{t}; p_{t} (GeV/c); d^{2}#sigma/(d#eta dp_{t}) [mb]", nPtBins, ptMin, ptMax);
-   TH1D *hPtLead =
-      new TH1D("hPtLead", "Leading Jet p_{t}; p_{t} (GeV/c); d^{2}#sigma/(d#eta dp_{t}) [mb]", nPtBins, ptMin, ptMax);
-   TH1D *hPtSub =
-      new TH1D("hPtSub", "Subleading Jet p_{t}; p_{t} (GeV/c); d^{2}#sigma/(d#eta dp_{t}) [mb]", nPtBins, ptMin, ptMax);
-   TH1D *hBalance = new TH1D("hBalance", "p_{t}^{lead}/p_{t}^{sublead}; p_{t}^{lead}/p_{t}^{sublead}", 50, 0, 1);
-   TH2D *hBalanceVsPt =
-      new TH2D("hBalanceVsPt",
-               "p_{t}^{sublead}/p_{t}^{lead} vs p_{t}^{lead}; p_{t}^{lead} (GeV/c); p_{t}^{sublead}/p_{t}^{lead}", 100,
-               ptMin, ptMax, 50, 0, 1);
-   TH2D *hBalanceVsLeSub = new TH2D(
-      "hBalanceVsLeSub",
-      "p_{t}^{sublead}/p_{t}^{lead} vs p_{t}^{lead} - p_{t}^{sublead}; p_{t}^{lead} - p_{t}^{sublead} (GeV/c); "
-      "p_{t}^{sublead}/p_{t}^{lead}",
-      100, ptMin, ptMax, 50, 0, 1);
-
-   TH1D *hCloseness = new TH1D("hCloseness", "Closeness; |#phi_{lead} - #phi_{sublead} - #pi/2|", 50, 0, 1);
-   TH2D *hClosenessVsPt = new TH2D(
-      "hClosenessVsPt", "Closeness vs p_{t}^{lead}; p_{t}^{lead} (GeV/c); |#phi_{lead} - #phi_{sublead}- #pi/2|", 100,
-      ptMin, ptMax, 100, 0, 1);
-   TH2D *hClosenessVsLeSub = new TH2D("hClosenessVsLeSub",
-                                      "Closeness vs p_{t}^{lead} - p_{t}^{sublead}; p_{t}^{lead} - p_{t}^{sublead} "
-                                      "(GeV/c); |#phi_{lead} - #phi_{sublead}- #pi/2|",
-                                      100, ptMin, ptMax, 100, 0, 1);
-
-   TH1D *stats;
-   vector<TString> statNames = {"nEvents", "nAccepted", "ptHatMin", "ptHatMax", "sigmaGen_mb", "sigmaErr_mb"};
+   void fill(const DijetSnapshot &snap, const AnaConfig &c)
+   {
+      const double *lead_pt = snap.lead_pt();
+      const double *sub_pt = snap.sub_pt();
+      const int32_t *lead_n_charged = snap.lead_n_charged();
+      const int32_t *sub_n_charged = snap.sub_n_charged();
+      const double *closeness = snap.closeness();
+      const float *background_mult_A = snap.background_mult_A();
+      const float *background_mult_B = snap.background_mult_B();
+      const double *weights = snap.weight();
+
+      const Long64_t nEntries = snap.size();
+      for (Long64_t i = 0; i < nEntries; ++i) {
+         const double weight = weights[i]; // xsec / nEvents, folded in by the snapshot
+         double balance = sub_pt[i] / lead_pt[i];
+         hBalance->Fill(balance, weight);
+         hBalanceVsPt->Fill(lead_pt[i], balance, weight);
+         hBalanceVsLeSub->Fill(lead_pt[i] - sub_pt[i], balance, weight);
 
-   double totalXsec = 0;
-   double totalNevents = 0;
-   for (const auto &bin : ptHatBins) {
-      TString fileName = prefix + bin + ".root";
+         hCloseness->Fill(closeness[i], weight);
+         hClosenessVsPt->Fill(lead_pt[i], closeness[i], weight);
+         hClosenessVsLeSub->Fill(lead_pt[i] - sub_pt[i], closeness[i], weight);
 
-      TFile *f = TFile::Open(fileName);
-      if (!f || f->IsZombie()) {
-         cerr << "Error: could not open file " << fileName << endl;
-         continue;
+         if (balance < c.balanceCut)
+            continue; // remove unbalanced dijets
+
+         hMult3D.fill(lead_n_charged[i], sub_n_charged[i], lead_pt[i], weight);
+         hMult3DLeSub.fill(lead_n_charged[i], sub_n_charged[i], lead_pt[i] - sub_pt[i], weight);
+         if (lead_pt[i] > c.leadPtMultCut) {
+            hMultLead->Fill(lead_n_charged[i], weight);
+            hMultSublead->Fill(sub_n_charged[i], weight);
+            hMultLeadVsSub->Fill(lead_n_charged[i], sub_n_charged[i], weight);
+         }
+         hPtAll->Fill(lead_pt[i], weight);
+         hPtAll->Fill(sub_pt[i], weight);
+         hPtLead->Fill(lead_pt[i], weight);
+         hPtSub->Fill(sub_pt[i], weight);
+         hPtLeSub->Fill(lead_pt[i] - sub_pt[i], weight);
+         hBackgroundMultAVsMultBVsPt.fill(background_mult_A[i], background_mult_B[i], lead_pt[i], weight);
+         hBackgroundMultAVsMultBVsLeSub.fill(background_mult_A[i], background_mult_B[i], lead_pt[i] - sub_pt[i],
+                                              weight);
+
+         double avgBackgroundMult = (background_mult_A[i] + background_mult_B[i]) / 2.0;
+
+         hBackgroundAverageMult->Fill(avgBackgroundMult, lead_pt[i], weight);
       }
+   }
 
-      stats = (TH1D *)f->Get("stats");
-      if (!stats) {
-         cerr << "Error: stats histogram not found in file " << fileName << endl;
-         f->Close();
-         continue;
+   // "mixed" tree of makeTree --mix-depth, if present; binWeight = xsec / nEvents
+   void fillMixed(const TString &rootFile, double binWeight, const AnaConfig &c)
+   {
+      TFile *f = TFile::Open(rootFile);
+      TTree *t = (f && !f->IsZombie()) ? (TTree *)f->Get("mixed") : nullptr;
+      if (!t) {
+         delete f;
+         return;
+      }
+      double lead_pt, sub_pt, background_mult_A, background_mult_B, weight;
+      t->SetBranchStatus("*", false);
+      for (const char *b : {"lead_pt", "sub_pt", "background_mult_A", "background_mult_B", "weight"})
+         t->SetBranchStatus(b, true);
+      t->SetBranchAddress("lead_pt", &lead_pt);
+      t->SetBranchAddress("sub_pt", &sub_pt);
+      t->SetBranchAddress("background_mult_A", &background_mult_A);
+      t->SetBranchAddress("background_mult_B", &background_mult_B);
+      t->SetBranchAddress("weight", &weight);
+      const Long64_t n = t->GetEntries();
+      for (Long64_t i = 0; i < n; ++i) {
+         t->GetEntry(i);
+         if (sub_pt / lead_pt < c.balanceCut)
+            continue; // same selection as the same-event cones
+         hMixedBackgroundMultAVsMultBVsPt.fill(background_mult_A, background_mult_B, lead_pt, binWeight * weight);
       }
-      totalNevents += stats->GetBinContent(1);
-      totalXsec += stats->GetBinContent(5); // mb
-      hStatistics->SetBinContent(hStatistics->GetXaxis()->FindBin(bin), stats->GetBinContent(1));
-      hAcceptedEvents->SetBinContent(hAcceptedEvents->GetXaxis()->FindBin(bin), stats->GetBinContent(2));
       f->Close();
+      delete f;
    }
-   cout << "Total cross section from all ptHat bins: " << totalXsec << " mb" << endl;
 
-   for (const auto &bin : ptHatBins) {
-      TString fileName = prefix + bin + ".root";
-
-      TFile *f = TFile::Open(fileName);
-      if (!f || f->IsZombie()) {
-         cerr << "Error: could not open file " << fileName << endl;
-         continue;
+   // Adds the histograms of the same names written by write() to dir; false
+   // (and nothing added) if one is missing. The sparse ones are read cell by
+   // cell, never as a dense TH3D.
+   bool add(TDirectory *dir)
+   {
+      std::vector<TH1 *> mine = all(), theirs;
+      for (TH1 *h : mine) {
+         TH1 *p = dynamic_cast<TH1 *>(dir->Get(h->GetName()));
+         if (!p)
+            return false;
+         theirs.push_back(p);
       }
-
-      stats = (TH1D *)f->Get("stats");
-      if (!stats) {
-         cerr << "Error: stats histogram not found in file " << fileName << endl;
-         f->Close();
-         continue;
+      std::vector<SparseHist3 *> mineSparse = sparse();
+      std::vector<SparseHist3> theirsSparse;
+      for (SparseHist3 *s : mineSparse) {
+         theirsSparse.push_back(s->emptyLike());
+         if (!theirsSparse.back().readCells(dir))
+            return false;
       }
-      int nEvents = stats->GetBinContent(1);
-      double xsec = stats->GetBinContent(5); // mb
+      for (size_t i = 0; i < mine.size(); ++i)
+         mine[i]->Add(theirs[i]);
+      for (size_t i = 0; i < mineSparse.size(); ++i)
+         mineSparse[i]->add(theirsSparse[i]);
+      return true;
+   }
 
-      // get it from name in bin  ptmin_ptmax using TString operations
-      double ptHatMin = -1;
-      double ptHatMax = -1;
+   void destroy()
+   {
+      for (TH1 *h : all())
+         delete h;
+      for (SparseHist3 *s : sparse())
+         *s = SparseHist3();
+   }
+};
 
-      ptHatMin = TString(bin(0, bin.Index("_"))).Atof();
-      ptHatMax = TString(bin(bin.Index("_") + 1, bin.Length())).Atof();
+// --- Per-file histogram cache ---
+// <input>.root -> <input>.<config hash>.anacache.root holds the weighted (mb)
+// histograms of that one file, the "stats" numbers of the input and a key made
+// of the input fingerprint and AnaConfig::hash(). The result is the sum of the
+// partials, so after one ptHat bin was regenerated only that file is read
+// again; runs with different configurations keep separate caches.
 
-      double weight = xsec / nEvents;
-      cout << "nEvents = " << nEvents / 1e6 << "M, accepted = " << stats->GetBinContent(2) / 1e6 << "M, xsec = " << xsec
-           << " mb, ptHat " << ptHatMin << "-" << ptHatMax << endl;
-      TTree *t = (TTree *)f->Get("events");
-      t->SetBranchAddress("lead_pt", &lead_pt);
-      t->SetBranchAddress("sub_pt", &sub_pt);
-      t->SetBranchAddress("lead_eta", &lead_eta);
-      t->SetBranchAddress("sub_eta", &sub_eta);
-      t->SetBranchAddress("lead_phi", &lead_phi);
-      t->SetBranchAddress("sub_phi", &sub_phi);
-      t->SetBranchAddress("lead_n_charged", &lead_n_charged);
-      t->SetBranchAddress("sub_n_charged", &sub_n_charged);
-      t->SetBranchAddress("closeness", &closeness);
-      t->SetBranchAddress("background_mult_A", &background_mult_A);
-      t->SetBranchAddress("background_mult_B", &background_mult_B);
+static TString anaCachePath(const TString &rootFile, const AnaConfig &cfg)
+{
+   TString path = rootFile;
+   if (path.EndsWith(".root"))
+      path = path(0, path.Length() - 5);
+   return path + Form(".%016llx.anacache.root", (unsigned long long)cfg.hash());
+}
 
-      Long64_t nEntries = t->GetEntries();
-      for (Long64_t i = 0; i < nEntries; ++i) {
-         t->GetEntry(i);
-         double balance = sub_pt / lead_pt;
-         hBalance->Fill(balance, weight);
-         hBalanceVsPt->Fill(lead_pt, balance, weight);
-         hBalanceVsLeSub->Fill(lead_pt - sub_pt, balance, weight);
+struct AnaPartialInfo {
+   double nEvents = 0;
+   double nAccepted = 0;
+   double xsec = 0; // mb
+};
+
+// Adds the cached partial to total. False if the cache is missing or stale.
+static bool addCachedPartial(const TString &path, const TString &key, AnaHistograms &total, AnaPartialInfo &info)
+{
+   if (gSystem->AccessPathName(path)) // true if it does not exist
+      return false;
+   TFile *f = TFile::Open(path, "READ");
+   if (!f || f->IsZombie()) {
+      delete f;
+      return false;
+   }
+   TNamed *storedKey = (TNamed *)f->Get("cacheKey");
+   TH1D *stats = (TH1D *)f->Get("stats");
+   bool ok = storedKey && stats && key == storedKey->GetTitle();
+   if (ok) {
+      info.nEvents = stats->GetBinContent(1);
+      info.nAccepted = stats->GetBinContent(2);
+      info.xsec = stats->GetBinContent(5);
+      ok = total.add(f);
+   }
+   f->Close();
+   delete f;
+   return ok;
+}
+
+static bool writePartial(const TString &path, const TString &key, const AnaHistograms &partial,
+                         const AnaPartialInfo &info)
+{
+   // unique temporary name: concurrent runs of the same configuration only share the final rename
+   TString tmp;
+   const int fd = DijetSnapshot::createTemp(path, tmp);
+   if (fd < 0) {
+      std::cerr << "Error: could not create histogram cache " << tmp << std::endl;
+      return false;
+   }
+   ::close(fd);
+   TFile *f = TFile::Open(tmp, "RECREATE");
+   if (!f || f->IsZombie()) {
+      std::cerr << "Error: could not create histogram cache " << tmp << std::endl;
+      delete f;
+      std::remove(tmp.Data());
+      return false;
+   }
+   f->cd();
+   partial.write();
+   // same layout as the makeTree "stats"; the snapshot carries no sigmaErr
+   TH1D *stats = makeStats((long long)info.nEvents, (long long)info.nAccepted, info.xsec, 0);
+   stats->Write();
+   delete stats;
+   TNamed("cacheKey", key.Data()).Write();
+   f->Close();
+   delete f;
+   if (std::rename(tmp.Data(), path.Data()) != 0) {
+      std::cerr << "Error: could not write histogram cache " << path << std::endl;
+      std::remove(tmp.Data());
+      return false;
+   }
+   return true;
+}
 
-         hCloseness->Fill(closeness, weight);
-         hClosenessVsPt->Fill(lead_pt, closeness, weight);
-         hClosenessVsLeSub->Fill(lead_pt - sub_pt, closeness, weight);
+static const TString kDefaultPrefix = "output/sum_pp200_ptHat_";
+static const vector<TString> kDefaultPtHatBins = {"2_3",   "3_4",   "4_5",   "5_7",   "7_9",   "9_11", "11_15",
+                                                  "15_20", "20_25", "25_35", "35_45", "45_55", "55_-1"};
 
-         if (balance < balanceCut)
-            continue; // remove unbalanced dijets
+// Analysis of the merged trees. labels[i] names inputs[i] (its ptHat bin "min_max") in the statistics histograms;
+// outName.root / outName.pdf are written. Inputs without a valid histogram cache are processed in nThreads threads.
+// Returns false if the output file could not be created.
+bool runAnaTrees(const vector<TString> &inputs, const vector<TString> &labels, const AnaConfig &cfg,
+                 const TString &outName, int nThreads)
+{
+   TH1::SetDefaultSumw2(true); // proper errors when scaling
+   TH3::SetDefaultSumw2(true);
+   TH2::SetDefaultSumw2(true);
+   // only show n entries in stats
+   gStyle->SetOptStat(0);
+   const TString pdfName = outName + ".pdf";
 
-         hMult3D->Fill(lead_n_charged, sub_n_charged, lead_pt, weight);
-         hMult3DLeSub->Fill(lead_n_charged, sub_n_charged, lead_pt - sub_pt, weight);
-         if (lead_pt > 70) {
-            hMultLead->Fill(lead_n_charged, weight);
-            hMultSublead->Fill(sub_n_charged, weight);
-            hMultLeadVsSub->Fill(lead_n_charged, sub_n_charged, weight);
-         }
-         hPtAll->Fill(lead_pt, weight);
-         hPtAll->Fill(sub_pt, weight);
-         hPtLead->Fill(lead_pt, weight);
-         hPtSub->Fill(sub_pt, weight);
-         hPtLeSub->Fill(lead_pt - sub_pt, weight);
-         hBackgroundMultAVsMultBVsPt->Fill(background_mult_A, background_mult_B, lead_pt, weight);
-         hBackgroundMultAVsMultBVsLeSub->Fill(background_mult_A, background_mult_B, lead_pt - sub_pt, weight);
+   TFile *outFile = TFile::Open(outName + ".root", "RECREATE");
+   if (!outFile || outFile->IsZombie()) {
+      std::cerr << "Error: could not create output file " << outName << ".root" << std::endl;
+      return false;
+   }
+   // add text with jet parameters as latex to Histograms
+
+   TH1D *hStatistics = new TH1D("hStatistics", "nEvents; ptHat range;nEvents", labels.size(), 0, labels.size());
+   for (size_t i = 0; i < labels.size(); ++i) {
+      hStatistics->GetXaxis()->SetBinLabel(i + 1, labels[i]);
+   }
 
-         double avgBackgroundMult = (background_mult_A + background_mult_B) / 2.0;
+   TH1D *hAcceptedEvents = (TH1D *)hStatistics->Clone("hAcceptedEvents");
+   hAcceptedEvents->SetTitle("nAcceptedEvents; ptHat range;nAcceptedEvents");
+
+   AnaHistograms hist;
+   hist.book(cfg);
+
+   // 1) add the valid caches, 2) fill the other inputs (in parallel), 3) add those in input order
+   const size_t nInputs = inputs.size();
+   vector<AnaPartialInfo> infos(nInputs);
+   vector<TString> cachePaths(nInputs), keys(nInputs);
+   vector<int> status(nInputs, 0); // 0 = unusable, 1 = cached, 2 = to fill, 3 = filled
+   for (size_t i = 0; i < nInputs; ++i) {
+      uint64_t fp = 0;
+      if (!DijetSnapshot::fingerprint(inputs[i], fp)) {
+         std::cerr << "Error: could not stat file " << inputs[i] << std::endl;
+         continue;
+      }
+      cachePaths[i] = anaCachePath(inputs[i], cfg);
+      keys[i] = Form("%016llx_%016llx", (unsigned long long)fp, (unsigned long long)cfg.hash());
+      if (addCachedPartial(cachePaths[i], keys[i], hist, infos[i])) {
+         cout << "Using cached histograms " << cachePaths[i] << endl;
+         status[i] = 1;
+      } else {
+         status[i] = 2;
+      }
+   }
 
-         hBackgroundAverageMult->Fill(avgBackgroundMult, lead_pt, weight);
+   vector<AnaHistograms> partials(nInputs);
+   std::atomic<size_t> next{0};
+   auto fillInputs = [&]() {
+      for (size_t i = next++; i < nInputs; i = next++) {
+         if (status[i] != 2)
+            continue;
+         // columnar snapshot of the merged tree, rebuilt only if the input changed
+         DijetSnapshot snap;
+         if (!snap.open(inputs[i]))
+            continue;
+         infos[i].nEvents = snap.nEvents();
+         infos[i].nAccepted = snap.nAccepted();
+         infos[i].xsec = snap.xsec();
+         partials[i].book(cfg);
+         partials[i].fill(snap, cfg);
+         partials[i].fillMixed(inputs[i], snap.xsec() / snap.nEvents(), cfg);
+         writePartial(cachePaths[i], keys[i], partials[i], infos[i]);
+         status[i] = 3;
       }
+   };
+   const bool addDirectory = TH1::AddDirectoryStatus();
+   TH1::AddDirectory(false); // partials belong to no file
+   if (nThreads > 1) {
+      ROOT::EnableThreadSafety();
+      vector<std::thread> threads;
+      for (int t = 0; t < nThreads; ++t)
+         threads.emplace_back(fillInputs);
+      for (auto &t : threads)
+         t.join();
+   } else {
+      fillInputs();
    }
+   TH1::AddDirectory(addDirectory);
 
-   TH1D *covVsPt = getCovariance(hMult3D, "COV(N_{ch}^{lead},N_{ch}^{sublead})");
-   TH1D *covVsLeSub = getCovariance(hMult3DLeSub, "COV(N_{ch}^{lead},N_{ch}^{sublead})");
-   TH1D *backgroundCovVsPt = getCovariance(hBackgroundMultAVsMultBVsPt, "COV(UE_{A},UE_{B})");
-   TH1D *backgroundCovVsLeSub = getCovariance(hBackgroundMultAVsMultBVsLeSub, "COV(UE_{A},UE_{B})");
+   double totalXsec = 0;
+   double totalNevents = 0;
+   for (size_t i = 0; i < nInputs; ++i) {
+      if (status[i] == 0 || status[i] == 2)
+         continue;
+      if (status[i] == 3) {
+         hist.add(partials[i]);
+         partials[i].destroy();
+      }
+      const AnaPartialInfo &info = infos[i];
+      const TString &bin = labels[i];
+
+      // get it from name in bin  ptmin_ptmax using TString operations
+      double ptHatMin = TString(bin(0, bin.Index("_"))).Atof();
+      double ptHatMax = TString(bin(bin.Index("_") + 1, bin.Length())).Atof();
+      cout << "nEvents = " << info.nEvents / 1e6 << "M, accepted = " << info.nAccepted / 1e6
+           << "M, xsec = " << info.xsec << " mb, ptHat " << ptHatMin << "-" << ptHatMax << endl;
+
+      totalNevents += info.nEvents;
+      totalXsec += info.xsec; // mb
+      hStatistics->SetBinContent(i + 1, info.nEvents);
+      hAcceptedEvents->SetBinContent(i + 1, info.nAccepted);
+   }
+   cout << "Total cross section from all ptHat bins: " << totalXsec << " mb" << endl;
+
+   TH1D *covVsPt = getCovariance(hist.hMult3D, "COV(N_{ch}^{lead},N_{ch}^{sublead})");
+   TH1D *covVsLeSub = getCovariance(hist.hMult3DLeSub, "COV(N_{ch}^{lead},N_{ch}^{sublead})");
+   TH1D *backgroundCovVsPt = getCovariance(hist.hBackgroundMultAVsMultBVsPt, "COV(UE_{A},UE_{B})");
+   TH1D *backgroundCovVsLeSub = getCovariance(hist.hBackgroundMultAVsMultBVsLeSub, "COV(UE_{A},UE_{B})");
 
    TCanvas *can = new TCanvas("can", "can", 800, 600);
    TLatex *latex = new TLatex();
@@ -377,52 +641,52 @@ void anaTrees()
    new TColor(3005, (25. / 255.), (0. / 255.), (25. / 255.));
    new TColor(3006, (49. / 255.), (61. / 255.), (90. / 255.));
 
-   can->SaveAs("anaTrees.pdf[");
+   can->SaveAs(pdfName + "[");
 
    outFile->cd();
    can->SetLogy();
    can->SetName("draw_ptAll");
-   hPtAll->SetLineColor(2002);
-   hPtAll->SetMarkerColor(2002);
-   hPtAll->Draw("E1");
-   drawLabel(can);
+   hist.hPtAll->SetLineColor(2002);
+   hist.hPtAll->SetMarkerColor(2002);
+   hist.hPtAll->Draw("E1");
+   drawLabel(can, cfg.balanceCut);
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
    can->SetLogy();
    can->SetName("draw_ptLeSub");
-   hPtLeSub->SetLineColor(2002);
-   hPtLeSub->SetMarkerColor(2002);
-   hPtLeSub->Draw("E1");
-   drawLabel(can);
+   hist.hPtLeSub->SetLineColor(2002);
+   hist.hPtLeSub->SetMarkerColor(2002);
+   hist.hPtLeSub->Draw("E1");
+   drawLabel(can, cfg.balanceCut);
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
    can->SetLogy(0);
 
    can->SetLogz(1);
 
    can->SetName("draw_MultLeadVsSub");
-   hMultLeadVsSub->DrawNormalized("colz");
-   drawLabel(can, 0.53, "p_{t}^{lead} > 70 GeV/c");
+   hist.hMultLeadVsSub->DrawNormalized("colz");
+   drawLabel(can, cfg.balanceCut, 0.53, Form("p_{t}^{lead} > %g GeV/c", cfg.leadPtMultCut));
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
    can->SetName("draw_MultLead");
-   hMultLead->SetLineColor(2002);
-   hMultLead->SetMarkerColor(2002);
-   hMultLead->DrawNormalized("E1");
-   drawLabel(can, 0.53, "p_{t}^{lead} > 70 GeV/c");
+   hist.hMultLead->SetLineColor(2002);
+   hist.hMultLead->SetMarkerColor(2002);
+   hist.hMultLead->DrawNormalized("E1");
+   drawLabel(can, cfg.balanceCut, 0.53, Form("p_{t}^{lead} > %g GeV/c", cfg.leadPtMultCut));
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
    can->SetName("draw_MultSublead");
-   hMultSublead->SetLineColor(2002);
-   hMultSublead->SetMarkerColor(2002);
-   hMultSublead->DrawNormalized("E1");
-   drawLabel(can, 0.53, "p_{t}^{lead} > 70 GeV/c");
+   hist.hMultSublead->SetLineColor(2002);
+   hist.hMultSublead->SetMarkerColor(2002);
+   hist.hMultSublead->DrawNormalized("E1");
+   drawLabel(can, cfg.balanceCut, 0.53, Form("p_{t}^{lead} > %g GeV/c", cfg.leadPtMultCut));
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
    /// COVARIANCE
    covVsPt->SetLineWidth(2);
@@ -443,7 +707,7 @@ void anaTrees()
    subtractedCovVsPt->SetLineColor(kBlack);
    subtractedCovVsPt->SetMarkerColor(kBlack);
    subtractedCovVsPt->Draw("same E1");
-   drawLabel(can, 0.15, "|#phi_{lead} - #phi_{A/B}| = #pi/2");
+   drawLabel(can, cfg.balanceCut, 0.15, "|#phi_{lead} - #phi_{A/B}| = #pi/2");
 
    TLegend *leg = new TLegend(0.15, 0.2, 0.5, 0.4);
    leg->SetBorderSize(0);
@@ -454,7 +718,36 @@ void anaTrees()
 
    can->SetName("draw_subtractedCovVsPt");
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
+
+   /// mixed-event baseline of the UE covariance
+   if (hist.hMixedBackgroundMultAVsMultBVsPt.entries() > 0) {
+      TH1D *mixedBackgroundCovVsPt = getCovariance(hist.hMixedBackgroundMultAVsMultBVsPt, "COV(UE_{A},UE_{B}^{mixed})");
+      can->Clear();
+      backgroundCovVsPt->Draw("E1");
+      mixedBackgroundCovVsPt->SetLineWidth(2);
+      mixedBackgroundCovVsPt->SetLineColor(2002);
+      mixedBackgroundCovVsPt->SetMarkerColor(2002);
+      mixedBackgroundCovVsPt->Draw("same E1");
+
+      TH1D *correlatedBackgroundCovVsPt = (TH1D *)backgroundCovVsPt->Clone("correlatedBackgroundCovVsPt");
+      correlatedBackgroundCovVsPt->Add(mixedBackgroundCovVsPt, -1);
+      correlatedBackgroundCovVsPt->SetLineColor(kBlack);
+      correlatedBackgroundCovVsPt->SetMarkerColor(kBlack);
+      correlatedBackgroundCovVsPt->Draw("same E1");
+      drawLabel(can, cfg.balanceCut, 0.53, "|#phi_{lead} - #phi_{A/B}| = #pi/2");
+
+      TLegend *legMixed = new TLegend(0.15, 0.6, 0.5, 0.8);
+      legMixed->SetBorderSize(0);
+      legMixed->AddEntry(backgroundCovVsPt, "COV(UE_{A},UE_{B})", "lp");
+      legMixed->AddEntry(mixedBackgroundCovVsPt, "COV(UE_{A},UE_{B}^{mixed})", "lp");
+      legMixed->AddEntry(correlatedBackgroundCovVsPt, "COV(UE_{A},UE_{B}) - COV(UE_{A},UE_{B}^{mixed})", "lp");
+      legMixed->Draw();
+
+      can->SetName("draw_mixedBackgroundCovVsPt");
+      can->Write();
+      can->SaveAs(pdfName);
+   }
 
    /// leSub
    can->Clear();
@@ -475,7 +768,7 @@ void anaTrees()
    subtractedCovVsLeSub->SetLineColor(kBlack);
    subtractedCovVsLeSub->SetMarkerColor(kBlack);
    subtractedCovVsLeSub->Draw("same E1");
-   drawLabel(can, 0.53, "|#phi_{lead} - #phi_{A/B}| = #pi/2");
+   drawLabel(can, cfg.balanceCut, 0.53, "|#phi_{lead} - #phi_{A/B}| = #pi/2");
    // set position of legend
    leg->SetX1NDC(0.53);
    leg->SetX2NDC(0.9);
@@ -484,27 +777,153 @@ void anaTrees()
 
    can->SetName("draw_subtractedCovVsLeSub");
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
    // make projections
-   drawProjectionsPt(can, hBalanceVsPt);
+   drawProjectionsPt(can, hist.hBalanceVsPt);
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
-   drawProjectionsPt(can, hBalanceVsLeSub);
+   drawProjectionsPt(can, hist.hBalanceVsLeSub);
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
-   drawProjectionsPt(can, hClosenessVsPt);
+   drawProjectionsPt(can, hist.hClosenessVsPt);
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
-   drawProjectionsPt(can, hClosenessVsLeSub);
+   drawProjectionsPt(can, hist.hClosenessVsLeSub);
    can->Write();
-   can->SaveAs("anaTrees.pdf");
+   can->SaveAs(pdfName);
 
-   can->SaveAs("anaTrees.pdf]");
+   can->SaveAs(pdfName + "]");
 
+   size_t sparseBytes = 0, denseBytes = 0;
+   for (const SparseHist3 *s : hist.sparse()) {
+      sparseBytes += s->bytes();
+      denseBytes += s->denseBytes();
+   }
+   cout << "Sparse multiplicity histograms: " << sparseBytes / 1048576. << " MB (dense TH3D: " << denseBytes / 1048576.
+        << " MB)" << endl;
+   outFile->cd();
+   hist.writeSparse();
    outFile->Write();
    outFile->Close();
-}
\ No newline at end of file
+   return true;
+}
+
+// ROOT macro entry point: root -l -b -q anaTrees/anaTrees.cpp+
+void anaTrees()
+{
+   vector<TString> inputs;
+   for (const TString &bin : kDefaultPtHatBins)
+      inputs.push_back(kDefaultPrefix + bin + ".root");
+   runAnaTrees(inputs, kDefaultPtHatBins, AnaConfig(), "anaTrees", 1);
+}
+
+#ifdef ANATREES_STANDALONE
+// Native executable: make anaTrees/anaTrees
+
+static void usage(const char *argv0)
+{
+   std::cerr << "Usage: " << argv0 << " [options] [input.root ...]\n"
+             << "Without inputs, PREFIX<bin>.root is read for every ptHat bin.\n"
+             << "  --prefix=PREFIX           input prefix [" << kDefaultPrefix << "]\n"
+             << "  --bins=a_b,c_d,...        ptHat bins [2_3,...,55_-1]\n"
+             << "  --out=NAME                writes NAME.root and NAME.pdf [anaTrees]\n"
+             << "  --threads=N               inputs filled in parallel [1]\n"
+             << "  --balance-cut=X           p_t^sublead/p_t^lead cut [0.2]\n"
+             << "  --lead-pt-mult-cut=X      p_t^lead threshold of the N_ch distributions [70]\n"
+             << "  --pt-bins=N,MIN,MAX       p_t^lead binning [20,0,100]\n"
+             << "  --mult-bins=N,MIN,MAX     N_ch binning [30,0,30]\n";
+}
+
+static vector<TString> splitList(const TString &s)
+{
+   vector<TString> out;
+   TObjArray *tokens = s.Tokenize(",");
+   for (int i = 0; i < tokens->GetEntries(); ++i)
+      out.push_back(((TObjString *)tokens->At(i))->GetString());
+   delete tokens;
+   return out;
+}
+
+static bool parseBinning(const TString &s, int &n, double &min, double &max)
+{
+   const vector<TString> v = splitList(s);
+   if (v.size() != 3)
+      return false;
+   n = v[0].Atoi();
+   min = v[1].Atof();
+   max = v[2].Atof();
+   return n > 0 && max > min;
+}
+
+// ptHat bin label of an input: the part after "ptHat_" of the file name, or the file name
+static TString labelOf(const TString &file)
+{
+   TString name = gSystem->BaseName(file);
+   if (name.EndsWith(".root"))
+      name = name(0, name.Length() - 5);
+   const int i = name.Index("ptHat_");
+   return i >= 0 ? TString(name(i + 6, name.Length())) : name;
+}
+
+int main(int argc, char *argv[])
+{
+   AnaConfig cfg;
+   TString prefix = kDefaultPrefix;
+   vector<TString> bins = kDefaultPtHatBins;
+   TString outName = "anaTrees";
+   int nThreads = 1;
+   vector<TString> inputs;
+
+   for (int i = 1; i < argc; ++i) {
+      const TString arg = argv[i];
+      if (!arg.BeginsWith("--")) {
+         inputs.push_back(arg);
+         continue;
+      }
+      const int eq = arg.Index("=");
+      const TString name = eq < 0 ? TString(arg(2, arg.Length())) : TString(arg(2, eq - 2));
+      const TString value = eq < 0 ? TString() : TString(arg(eq + 1, arg.Length()));
+      bool ok = true;
+      if (name == "prefix")
+         prefix = value;
+      else if (name == "bins")
+         bins = splitList(value);
+      else if (name == "out")
+         outName = value;
+      else if (name == "threads")
+         ok = (nThreads = value.Atoi()) >= 1;
+      else if (name == "balance-cut")
+         cfg.balanceCut = value.Atof();
+      else if (name == "lead-pt-mult-cut")
+         cfg.leadPtMultCut = value.Atof();
+      else if (name == "pt-bins")
+         ok = parseBinning(value, cfg.nPtBins, cfg.ptMin, cfg.ptMax);
+      else if (name == "mult-bins")
+         ok = parseBinning(value, cfg.nMultBins, cfg.multMin, cfg.multMax);
+      else
+         ok = false;
+      if (!ok) {
+         std::cerr << "[error] bad option " << arg << "\n";
+         usage(argv[0]);
+         return 1;
+      }
+   }
+
+   vector<TString> labels;
+   if (inputs.empty()) {
+      for (const TString &bin : bins) {
+         inputs.push_back(prefix + bin + ".root");
+         labels.push_back(bin);
+      }
+   } else {
+      for (const TString &file : inputs)
+         labels.push_back(labelOf(file));
+   }
+
+   return runAnaTrees(inputs, labels, cfg, outName, nThreads) ? 0 : 1;
+}
+#endif
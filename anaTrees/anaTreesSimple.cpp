@@ -11,6 +11,8 @@
 #include <TColor.h>
 #include <iostream>
 
+#include "DijetSnapshot.h"
+
 #include <vector>
 
 static const double balanceCut = 0.2;
@@ -86,9 +88,6 @@ void anaTreesSimple()
    vector<TString> ptHatBins = {"2_3",   "3_4",   "4_5",   "5_7",   "7_9",   "9_11", "11_15",
                                 "15_20", "20_25", "25_35", "35_45", "45_55", "55_-1"};
 
-   int lead_n_charged, sub_n_charged;
-   double lead_pt, sub_pt, lead_eta, sub_eta, lead_phi, sub_phi, closeness, background_mult_A, background_mult_B;
-
    TFile *outFile = TFile::Open("anaTrees.root", "RECREATE");
    // add text with jet parameters as latex to Histograms
 
@@ -110,53 +109,35 @@ void anaTreesSimple()
                "Background multiplicity; N_{ch}^{A};N_{ch}^{B};p_{t}^{lead} (GeV/c); d#sigma/dN [mb]", nMultBins,
                multMin, multMax, nMultBins, multMin, multMax, nPtBins, ptMin, ptMax);
 
-   TH1D *stats;
-   vector<TString> statNames = {"nEvents", "nAccepted", "ptHatMin", "ptHatMax", "sigmaGen_mb", "sigmaErr_mb"};
-
    for (const auto &bin : ptHatBins) {
       TString fileName = prefix + bin + ".root";
 
-      TFile *f = TFile::Open(fileName);
-
-      stats = (TH1D *)f->Get("stats");
-      int nEvents = stats->GetBinContent(1);
-      double xsec = stats->GetBinContent(5); // mb
-
-      // get it from name in bin  ptmin_ptmax using TString operations
-      double ptHatMin = -1;
-      double ptHatMax = -1;
-
-      ptHatMin = TString(bin(0, bin.Index("_"))).Atof();
-      ptHatMax = TString(bin(bin.Index("_") + 1, bin.Length())).Atof();
-
-      double weight = xsec / nEvents;
+      // columnar snapshot of the merged tree, rebuilt only if the input changed
+      DijetSnapshot snap;
+      if (!snap.open(fileName))
+         continue;
 
-      TTree *t = (TTree *)f->Get("events");
-      t->SetBranchAddress("lead_pt", &lead_pt);
-      t->SetBranchAddress("sub_pt", &sub_pt);
-      t->SetBranchAddress("lead_eta", &lead_eta);
-      t->SetBranchAddress("sub_eta", &sub_eta);
-      t->SetBranchAddress("lead_phi", &lead_phi);
-      t->SetBranchAddress("sub_phi", &sub_phi);
-      t->SetBranchAddress("lead_n_charged", &lead_n_charged);
-      t->SetBranchAddress("sub_n_charged", &sub_n_charged);
-      t->SetBranchAddress("closeness", &closeness);
-      t->SetBranchAddress("background_mult_A", &background_mult_A);
-      t->SetBranchAddress("background_mult_B", &background_mult_B);
+      const double *lead_pt = snap.lead_pt();
+      const double *sub_pt = snap.sub_pt();
+      const int32_t *lead_n_charged = snap.lead_n_charged();
+      const int32_t *sub_n_charged = snap.sub_n_charged();
+      const float *background_mult_A = snap.background_mult_A();
+      const float *background_mult_B = snap.background_mult_B();
+      const double *weight = snap.weight(); // xsec / nEvents
 
-      Long64_t nEntries = t->GetEntries();
+      const Long64_t nEntries = snap.size();
 
       for (Long64_t i = 0; i < nEntries; ++i) {
-         t->GetEntry(i);
-         double balance = sub_pt / lead_pt;
+         double balance = sub_pt[i] / lead_pt[i];
 
          if (balance < balanceCut)
             continue; // remove unbalanced dijets
 
-         hMult3D->Fill(lead_n_charged, sub_n_charged, lead_pt, weight);
-         hBackgroundMultAVsMultBVsPt->Fill(background_mult_A, background_mult_B, lead_pt, weight);
+         hMult3D->Fill(lead_n_charged[i], sub_n_charged[i], lead_pt[i], weight[i]);
+         hBackgroundMultAVsMultBVsPt->Fill(background_mult_A[i], background_mult_B[i], lead_pt[i], weight[i]);
       }
    }
+   outFile->cd(); // the results below belong to the output file, whatever the inputs left in gDirectory
    TH1D *covVsPt = getCovariance(hMult3D, "COV(N_{ch}^{lead},N_{ch}^{sublead})");
    TH1D *backgroundCovVsPt = getCovariance(hBackgroundMultAVsMultBVsPt, "COV(UE_{A},UE_{B})");
 
@@ -0,0 +1,135 @@
+#include "TCanvas.h"
+#include "TFile.h"
+#include "TH1D.h"
+#include "TObjArray.h"
+#include "TObjString.h"
+#include "TStyle.h"
+#include "TSystem.h"
+#include <iostream>
+
+#include "../QuickLook.h"
+
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <utility>
+#include <vector>
+
+// Quick look at running (or finished) makeTree jobs: merges the <output>.quicklook snapshots matching pattern.
+// Jobs of the same ptHat bin are summed and weighted by sigmaGen / nEvents of the bin, so the result has the
+// shape of the final cross-section-weighted distributions. Writes quickLook.root / quickLook.pdf.
+//
+//   root -l -b -q 'anaTrees/quickLook.cpp+("output/*.quicklook")'
+
+struct QuickLookBin {
+   int nJobs = 0, nDone = 0;
+   double events = 0, accepted = 0, pairs = 0;
+   double sigmaSum = 0; // events-weighted
+   std::vector<double> leadPt = std::vector<double>(QuickLookData::kNLeadPt + 2);
+   std::vector<double> leadNch = std::vector<double>(QuickLookData::kNLeadNch + 2);
+   std::vector<double> closeness = std::vector<double>(QuickLookData::kNCloseness + 2);
+
+   void add(const QuickLookData &d)
+   {
+      ++nJobs;
+      nDone += d.done;
+      events += d.events;
+      accepted += d.accepted;
+      pairs += d.pairs;
+      sigmaSum += d.sigmaGen * d.events;
+      for (size_t i = 0; i < leadPt.size(); ++i)
+         leadPt[i] += d.leadPt[i];
+      for (size_t i = 0; i < leadNch.size(); ++i)
+         leadNch[i] += d.leadNch[i];
+      for (size_t i = 0; i < closeness.size(); ++i)
+         closeness[i] += d.closeness[i];
+   }
+};
+
+static void addTo(TH1D *h, const std::vector<double> &counts, double weight)
+{
+   for (size_t i = 0; i < counts.size(); ++i)
+      h->SetBinContent(i, h->GetBinContent(i) + weight * counts[i]);
+}
+
+void quickLook(TString pattern = "output/*.quicklook")
+{
+   gStyle->SetOptStat(0);
+   TString list = gSystem->GetFromPipe("ls -1 " + pattern + " 2>/dev/null");
+   TObjArray *files = list.Tokenize("\n");
+
+   std::map<std::pair<double, double>, QuickLookBin> bins;
+   printf("%-60s %7s %12s %8s %10s %9s %8s %5s\n", "job", "ptHat", "events", "accept", "events/s", "age[s]", "cost[%]",
+          "done");
+   for (int i = 0; i < files->GetEntries(); ++i) {
+      const TString file = ((TObjString *)files->At(i))->GetString();
+      QuickLookData d;
+      if (!QuickLookData::read(file, d)) {
+         std::cerr << "Error: cannot read snapshot " << file << std::endl;
+         continue;
+      }
+      Long_t id, flags, modtime;
+      Long64_t size;
+      gSystem->GetPathInfo(file, &id, &size, &flags, &modtime);
+      printf("%-60s %3.0f-%-3.0f %12lld %8.4f %10.1f %9ld %8.4f %5s\n", gSystem->BaseName(file), d.ptHatMin,
+             d.ptHatMax, d.events, d.events > 0 ? double(d.accepted) / d.events : 0.,
+             d.elapsed > 0 ? d.events / d.elapsed : 0., long(time(nullptr) - modtime), 100 * d.costFraction,
+             d.done ? "yes" : "no");
+      bins[{d.ptHatMin, d.ptHatMax}].add(d);
+   }
+   delete files;
+   if (bins.empty()) {
+      std::cerr << "Error: no snapshots match " << pattern << std::endl;
+      return;
+   }
+
+   TFile *outFile = TFile::Open("quickLook.root", "RECREATE");
+   TH1D *hLeadPt = new TH1D("hLeadPt", "Leading jet p_{t}; p_{t}^{lead} (GeV/c); d#sigma/dp_{t} [mb]",
+                            QuickLookData::kNLeadPt, 0, QuickLookData::kLeadPtMax);
+   TH1D *hLeadNch = new TH1D("hLeadNch", "Leading jet multiplicity; N_{ch}^{lead}; d#sigma/dN [mb]",
+                             QuickLookData::kNLeadNch, 0, QuickLookData::kLeadNchMax);
+   TH1D *hCloseness = new TH1D("hCloseness", "Closeness; #pi - |#phi_{lead} - #phi_{sublead}|; d#sigma [mb]",
+                               QuickLookData::kNCloseness, 0, QuickLookData::kClosenessMax);
+   TH1D *hAcceptance = new TH1D("hAcceptance", "Accepted fraction; ptHat range; nAccepted / nEvents", bins.size(), 0,
+                                bins.size());
+
+   int iBin = 0;
+   bool unweighted = false;
+   for (const auto &b : bins) {
+      const QuickLookBin &q = b.second;
+      ++iBin;
+      hAcceptance->GetXaxis()->SetBinLabel(iBin, Form("%g_%g (%d/%d)", b.first.first, b.first.second, q.nDone,
+                                                      q.nJobs));
+      if (q.events <= 0)
+         continue;
+      hAcceptance->SetBinContent(iBin, q.accepted / q.events);
+      // sigmaGen is 0 while unknown (pipelined jobs): then the bin is only normalised per event
+      double weight = q.sigmaSum / q.events / q.events;
+      if (q.sigmaSum <= 0) {
+         weight = 1 / q.events;
+         unweighted = true;
+      }
+      addTo(hLeadPt, q.leadPt, weight);
+      addTo(hLeadNch, q.leadNch, weight);
+      addTo(hCloseness, q.closeness, weight);
+   }
+   if (unweighted)
+      std::cerr << "Warning: some ptHat bins have no sigmaGen yet and are normalised per event only" << std::endl;
+
+   TCanvas *can = new TCanvas("can", "quick look", 1000, 800);
+   can->Divide(2, 2);
+   can->cd(1)->SetLogy();
+   hLeadPt->Draw("HIST");
+   can->cd(2)->SetLogy();
+   hLeadNch->Draw("HIST");
+   can->cd(3);
+   hCloseness->Draw("HIST");
+   can->cd(4);
+   hAcceptance->Draw("HIST");
+   can->SaveAs("quickLook.pdf");
+
+   outFile->cd();
+   can->Write();
+   outFile->Write();
+   outFile->Close();
+}
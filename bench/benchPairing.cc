@@ -0,0 +1,112 @@
+// Benchmark of the dijet pairing: DijetPairing vs the all-pairs reference it replaced,
+// for 2 .. maxJets jets per event (uniform in phi, pt-ordered), same dPhiMin as makeTree.
+//
+//   make bench/benchPairing && ./bench/benchPairing [maxJets=512] [seed=1]
+//
+// Both must choose identical pairs; the time per event and the speedup are printed.
+#include "DijetPairing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <random>
+#include <vector>
+
+struct Jet {
+   double pt_, phi_;
+   double pt() const { return pt_; }
+   double phi() const { return phi_; }
+};
+
+// the previous findDijets pairing (all pairs, then greedy), with a strict comparator
+static std::vector<DijetPairing::Pair> referencePairing(const std::vector<Jet> &jets, double dPhiMin)
+{
+   std::vector<DijetPairing::Pair> pairs;
+   for (size_t i = 0; i < jets.size(); ++i) {
+      for (size_t j = i + 1; j < jets.size(); ++j) {
+         double dphi = std::abs(std::remainder(jets[i].phi() - jets[j].phi(), 2 * M_PI));
+         if (dphi < dPhiMin)
+            continue;
+         int lead = i, sub = j;
+         if (jets[j].pt() > jets[i].pt())
+            std::swap(lead, sub);
+         pairs.push_back({lead, sub, M_PI - dphi});
+      }
+   }
+   std::sort(pairs.begin(), pairs.end(), [](const DijetPairing::Pair &a, const DijetPairing::Pair &b) {
+      if (a.closeness != b.closeness)
+         return a.closeness < b.closeness;
+      if (a.lead != b.lead)
+         return a.lead < b.lead;
+      return a.sub < b.sub;
+   });
+   std::vector<int> used(jets.size(), 0);
+   std::vector<DijetPairing::Pair> chosen;
+   for (const auto &p : pairs) {
+      if (!used[p.lead] && !used[p.sub]) {
+         chosen.push_back(p);
+         used[p.lead] = used[p.sub] = 1;
+      }
+   }
+   return chosen;
+}
+
+static bool samePairs(const std::vector<DijetPairing::Pair> &a, const std::vector<DijetPairing::Pair> &b)
+{
+   if (a.size() != b.size())
+      return false;
+   for (size_t i = 0; i < a.size(); ++i) {
+      if (a[i].lead != b[i].lead || a[i].sub != b[i].sub || std::abs(a[i].closeness - b[i].closeness) > 1e-12)
+         return false;
+   }
+   return true;
+}
+
+int main(int argc, char *argv[])
+{
+   const int maxJets = argc > 1 ? std::atoi(argv[1]) : 512;
+   const unsigned seed = argc > 2 ? std::atoi(argv[2]) : 1;
+   const double dPhiMin = 0.75 * M_PI;
+
+   std::mt19937_64 rng(seed);
+   std::uniform_real_distribution<double> uniform(0, 1);
+   DijetPairing pairing;
+
+   std::printf("%8s %10s %12s %14s %14s %9s %10s\n", "jets", "events", "candidates", "reference[us]", "binned[us]",
+               "speedup", "identical");
+   for (int n = 2; n <= maxJets; n *= 2) {
+      // about the same number of jet pairs per point
+      const int nEvents = std::max(20, int(4e6 / (double(n) * n)));
+      std::vector<std::vector<Jet>> events(nEvents);
+      for (auto &jets : events) {
+         for (int i = 0; i < n; ++i)
+            jets.push_back({3 - 10 * std::log(uniform(rng)), 2 * M_PI * uniform(rng)});
+         std::sort(jets.begin(), jets.end(), [](const Jet &a, const Jet &b) { return a.pt() > b.pt(); });
+      }
+
+      bool identical = true;
+      size_t candidates = 0, sink = 0;
+      for (const auto &jets : events) {
+         identical = identical && samePairs(pairing.pair(jets, dPhiMin), referencePairing(jets, dPhiMin));
+         candidates += pairing.nCandidates();
+      }
+
+      auto time = [&](const std::function<size_t(const std::vector<Jet> &)> &f) {
+         const auto t0 = std::chrono::steady_clock::now();
+         for (const auto &jets : events)
+            sink += f(jets);
+         return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count() / nEvents;
+      };
+      const double tReference = time([&](const std::vector<Jet> &jets) { return referencePairing(jets, dPhiMin).size(); });
+      const double tBinned = time([&](const std::vector<Jet> &jets) { return pairing.pair(jets, dPhiMin).size(); });
+
+      std::printf("%8d %10d %12.1f %14.3f %14.3f %9.2f %10s\n", n, nEvents, double(candidates) / nEvents, tReference,
+                  tBinned, tReference / tBinned, identical ? "yes" : "NO");
+      if (sink == 0)
+         std::printf("\n"); // keep the timed calls alive
+   }
+   return 0;
+}
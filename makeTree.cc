@@ -2,7 +2,17 @@
 #include "Pythia8/Pythia.h"
 #include <iostream>
 #include <vector>
+#include <cerrno>
 #include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
 
 #include "fastjet/ClusterSequence.hh"
 
@@ -13,15 +23,21 @@
 #include "TRandom3.h"
 #include "TF1.h"
 
-using namespace Pythia8;
+#include "TChain.h"
+#include "TROOT.h"
 
-struct DijetPair {
-   int lead; // index in jet array
-   int sub;
+#include "BoundedQueue.h"
+#include "DijetPairing.h"
+#include "EtaPhiGrid.h"
+#include "EventMixer.h"
+#include "MemoryUsage.h"
+#include "MinBiasPool.h"
+#include "QuickLook.h"
+#include "RunControl.h"
+#include "RunStats.h"
+#include "WorkerPool.h"
 
-   double dphi;      // in [0, M_PI]
-   double closeness; // = M_PI - dphi (smaller is better / closer to back-to-back)
-};
+using namespace Pythia8;
 
 double deltaPhi(double phi1, double phi2) // return value in (-PI, PI]
 {
@@ -40,27 +56,6 @@ double deltaR(double eta1, double phi1, double eta2, double phi2)
    return std::sqrt(deta * deta + dphi * dphi);
 }
 
-// Count charged final-state particles in a cone of radius R around (eta0, phi0)
-template <class PartContainer>
-int countInCone(const PartContainer &parts, double eta0, double phi0, double R, double partPtMin, double partEtaMax)
-{
-   if (std::abs(eta0) > partEtaMax - R)
-      return 0; // require cone fully inside
-   int n = 0;
-   for (const auto &p : parts) {
-      const double pt = p.pt();
-      if (pt < partPtMin)
-         continue;
-      const double eta = p.eta();
-      if (std::abs(eta) > partEtaMax)
-         continue;
-      const double phi = p.phi();
-      if (deltaR(eta, phi, eta0, phi0) < R)
-         ++n;
-   }
-   return n;
-}
-
 static std::string trim_trailing_zeros(double x)
 {
    std::ostringstream os;
@@ -74,69 +69,402 @@ static std::string trim_trailing_zeros(double x)
    return s.empty() ? "0" : s;
 }
 
-bool isAcceptedTrack(double pt, TF1 &eff)
+// Command line: positional arguments plus "--name=value" options anywhere.
+class CmdOptions {
+ public:
+   CmdOptions(int argc, char *argv[])
+   {
+      for (int i = 1; i < argc; ++i) {
+         std::string a = argv[i];
+         if (a.rfind("--", 0) != 0) {
+            fPositional.push_back(a);
+            continue;
+         }
+         const size_t eq = a.find('=');
+         fNamed[a.substr(2, eq == std::string::npos ? std::string::npos : eq - 2)] =
+            (eq == std::string::npos) ? "1" : a.substr(eq + 1);
+      }
+   }
+
+   const std::vector<std::string> &positional() const { return fPositional; }
+
+   std::string get(const std::string &name, const std::string &def)
+   {
+      fUsed.insert(name);
+      auto it = fNamed.find(name);
+      return it == fNamed.end() ? def : it->second;
+   }
+   // numeric option; a malformed value is recorded for checkValues() and def returned
+   double get(const std::string &name, double def)
+   {
+      const std::string v = get(name, std::string());
+      return v.empty() ? def : number(v, "--" + name, def);
+   }
+   // numeric positional argument i (0-based), def if absent or malformed
+   double positional(size_t i, double def)
+   {
+      return i < fPositional.size() ? number(fPositional[i], "argument " + std::to_string(i + 1), def) : def;
+   }
+
+   // Returns false (and reports) if a numeric option or argument could not be parsed.
+   bool checkValues() const
+   {
+      for (const auto &bad : fMalformed)
+         std::cerr << "[error] malformed number for " << bad << "\n";
+      return fMalformed.empty();
+   }
+
+   // Returns false (and reports) if an option was given that nobody asked for.
+   bool checkUnused() const
+   {
+      bool ok = true;
+      for (const auto &kv : fNamed) {
+         if (!fUsed.count(kv.first)) {
+            std::cerr << "[error] unknown option --" << kv.first << "\n";
+            ok = false;
+         }
+      }
+      return ok;
+   }
+
+ private:
+   // the whole string must be a finite number ("1e5x", "abc" and "" are rejected)
+   double number(const std::string &v, const std::string &what, double def)
+   {
+      errno = 0;
+      char *end = nullptr;
+      const double x = std::strtod(v.c_str(), &end);
+      if (v.empty() || end != v.c_str() + v.size() || errno == ERANGE || !std::isfinite(x)) {
+         fMalformed.push_back(what + ": '" + v + "'");
+         return def;
+      }
+      return x;
+   }
+
+   std::vector<std::string> fPositional, fMalformed;
+   std::map<std::string, std::string> fNamed;
+   std::set<std::string> fUsed;
+};
+
+bool isAcceptedTrack(double pt, TF1 &eff, TRandom &rng)
 {
    if (pt > 30)
       return false; // reject very high pt tracks
 
-   return gRandom->Rndm() < eff.Eval(pt);
+   return rng.Rndm() < eff.Eval(pt);
 }
 
-int main(int argc, char *argv[])
+// jet and particle selection (set in main)
+struct JetCuts {
+   double jetRadius;
+   double jetEtaMax;
+   double dPhiMin;
+   double jetPtMin;
+   double partPtMin;
+   double partEtaMax;
+   double matchRadius; // particle <-> detector level jet matching, 0 = detector level only
+};
+
+// One entry of the events tree
+struct DijetRecord {
+   int lead_n_charged, sub_n_charged;
+   double lead_pt, sub_pt, lead_eta, sub_eta, lead_phi, sub_phi, closeness, background_mult_A, background_mult_B;
+   double weight;     // 1 / hadron-level copies of the event
+   Long64_t event_id; // shared by all entries of one generated event
+   int n_pileup;      // overlaid minimum-bias events
+   int n_tracks;      // selected tracks in the event, pileup included
+   // closest jet of the other level (particle level for detector dijets and vice versa), -1 if unmatched
+   double lead_pt_match, sub_pt_match;
+   int lead_n_charged_match, sub_n_charged_match;
+};
+
+// matchLevel: suffix of the matched-jet branches ("truth" / "det"), nullptr = no matching
+void branchDijetRecord(TTree *t, DijetRecord &r, const char *matchLevel = nullptr)
 {
-   gRandom->SetSeed(0); // use random seed based on machine time
-   if (argc < 3) {
-      std::cerr << "Usage: " << argv[0]
-                << " pTHatMin pTHatMax|inf [nEvents=50000] [SEED=12345]"
-                   " [OUTPREFIX=pp200_HardQCD]\n";
-      return 1;
+   t->Branch("lead_pt", &r.lead_pt, "lead_pt/D");
+   t->Branch("sub_pt", &r.sub_pt, "sub_pt/D");
+   t->Branch("lead_eta", &r.lead_eta, "lead_eta/D");
+   t->Branch("sub_eta", &r.sub_eta, "sub_eta/D");
+   t->Branch("lead_phi", &r.lead_phi, "lead_phi/D");
+   t->Branch("sub_phi", &r.sub_phi, "sub_phi/D");
+   t->Branch("lead_n_charged", &r.lead_n_charged, "lead_n_charged/I");
+   t->Branch("sub_n_charged", &r.sub_n_charged, "sub_n_charged/I");
+   t->Branch("background_mult_A", &r.background_mult_A, "background_mult_A/D");
+   t->Branch("background_mult_B", &r.background_mult_B, "background_mult_B/D");
+   t->Branch("closeness", &r.closeness, "closeness/D");
+   t->Branch("weight", &r.weight, "weight/D");
+   t->Branch("event_id", &r.event_id, "event_id/L");
+   t->Branch("n_pileup", &r.n_pileup, "n_pileup/I");
+   t->Branch("n_tracks", &r.n_tracks, "n_tracks/I");
+   if (matchLevel) {
+      const std::string sfx = std::string("_") + matchLevel;
+      t->Branch(("lead_pt" + sfx).c_str(), &r.lead_pt_match, ("lead_pt" + sfx + "/D").c_str());
+      t->Branch(("sub_pt" + sfx).c_str(), &r.sub_pt_match, ("sub_pt" + sfx + "/D").c_str());
+      t->Branch(("lead_n_charged" + sfx).c_str(), &r.lead_n_charged_match, ("lead_n_charged" + sfx + "/I").c_str());
+      t->Branch(("sub_n_charged" + sfx).c_str(), &r.sub_n_charged_match, ("sub_n_charged" + sfx + "/I").c_str());
    }
+}
 
-   TF1 eff("eff", "[0]*(1-exp(-pow(x/[1],[2])))", 0, 30);
-   eff.SetParameters(0.88, 0.25, 1.2); // eff_max, p0, n
+// Selected jet, kept after its ClusterSequence is gone (for matching through EtaPhiGrid)
+struct JetInfo {
+   double jetPt, jetEta, jetPhi; // phi in [0, 2pi)
+   int nCharged;
 
-   // Required: pTHatMin
-   const double ptHatMin = std::stod(argv[1]);
+   double pt() const { return jetPt; }
+   double eta() const { return jetEta; }
+   double phi() const { return jetPhi; }
+};
 
-   // Required: pTHatMax (can be "inf" or negative for open upper bound)
-   double ptHatMax;
-   std::string s = argv[2];
-   if (s == "inf" || s == "Inf" || s == "INF") {
-      ptHatMax = -1.0;
-   } else {
-      ptHatMax = std::stod(s);
+// One entry of the mixed tree: cone A of a dijet with cone B of an earlier dijet of the same class
+struct MixedRecord {
+   double lead_pt, sub_pt, background_mult_A, background_mult_B;
+   double weight; // weight of the dijet / number of its mixed partners (other events only)
+   Long64_t event_id;
+};
+
+struct MixedEvents {
+   std::unique_ptr<EventMixer> mixer;
+   TTree *tree = nullptr;
+   MixedRecord rec;
+   std::vector<float> partners;
+
+   // Books the "mixed" tree in the current directory; mixing is off for depth 0.
+   void book(int depth, int capacity)
+   {
+      if (depth <= 0)
+         return;
+      // classes: lead-jet pT and number of selected tracks
+      const std::vector<double> ptEdges = {3, 5, 7, 10, 15, 20, 30, 50};
+      const std::vector<double> multEdges = {0, 10, 20, 30, 40, 60, 100, 200, 500};
+      mixer.reset(new EventMixer(ptEdges, multEdges, capacity, depth));
+      partners.reserve(depth);
+      tree = new TTree("mixed", "mixed-event perpendicular cones");
+      tree->Branch("lead_pt", &rec.lead_pt, "lead_pt/D");
+      tree->Branch("sub_pt", &rec.sub_pt, "sub_pt/D");
+      tree->Branch("background_mult_A", &rec.background_mult_A, "background_mult_A/D");
+      tree->Branch("background_mult_B", &rec.background_mult_B, "background_mult_B/D");
+      tree->Branch("weight", &rec.weight, "weight/D");
+      tree->Branch("event_id", &rec.event_id, "event_id/L");
    }
 
-   if (ptHatMax > 0.0 && ptHatMax < ptHatMin) {
-      std::cerr << "[error] pTHatMax < pTHatMin\n";
-      return 1;
+   void fill(const DijetRecord &r)
+   {
+      if (!mixer)
+         return;
+      partners.clear();
+      const int n = mixer->mix(r.lead_pt, r.n_tracks, r.background_mult_B, r.event_id,
+                               [&](float b) { partners.push_back(b); });
+      rec.lead_pt = r.lead_pt;
+      rec.sub_pt = r.sub_pt;
+      rec.background_mult_A = r.background_mult_A;
+      rec.event_id = r.event_id;
+      for (float b : partners) {
+         rec.background_mult_B = b;
+         rec.weight = r.weight / n;
+         tree->Fill();
+      }
    }
+};
 
-   int nEvents = (argc > 3) ? std::atoi(argv[3]) : 50000;
-   int seed = (argc > 4) ? std::stoi(argv[4]) : 12345;
-   std::string out = (argc > 5) ? argv[5] : "pp200";
+// value of the --observable used for the precision stop criterion
+double pairObservable(const DijetRecord &r, const std::string &observable)
+{
+   if (observable == "lead_n_charged")
+      return r.lead_n_charged;
+   if (observable == "sub_n_charged")
+      return r.sub_n_charged;
+   if (observable == "lead_pt")
+      return r.lead_pt;
+   return 0.5 * (r.background_mult_A + r.background_mult_B);
+}
 
-   // jet parameter
-   const double jetRadius = 0.4;
-   const double jetEtaMax = 1.0 - jetRadius;
-   const double dPhiMin = 0.75 * M_PI; // back-to-back requirement
-   const double jetPtMin = 3.0;
-   // particle parameters
-   const double partPtMin = 0.15;
-   const double partEtaMax = 1.0;
+// Build input particles for jet finding: charged final-state tracks in acceptance
+// that survive the tracking efficiency. truth (optional) gets all of them, before the efficiency.
+void selectTracks(const Pythia8::Event &event, const JetCuts &cuts, TF1 &eff, TRandom &rng,
+                  std::vector<fastjet::PseudoJet> &parts, std::vector<fastjet::PseudoJet> *truth = nullptr)
+{
+   parts.clear();
+   if (truth)
+      truth->clear();
+   for (int i = 0; i < event.size(); ++i) {
+      const auto &p = event[i];
+      // final-state, visible (no neutrinos), basic kinematic filter
+      if (!p.isFinal() || !p.isVisible())
+         continue;
+      if (!p.isCharged())
+         continue; // charged only
+      // exclude neutrinos (should be covered by isVisible())
+      if (p.idAbs() == 12 || p.idAbs() == 14 || p.idAbs() == 16)
+         continue;
+      if (std::abs(p.eta()) > cuts.partEtaMax)
+         continue; // wide acceptance for clustering
+      if (p.pT() < cuts.partPtMin)
+         continue;
+      fastjet::PseudoJet pj(p.px(), p.py(), p.pz(), p.e());
+      pj.set_user_index(i); // <— keep Pythia index
+      if (truth)
+         truth->push_back(pj);
+      if (!isAcceptedTrack(p.pT(), eff, rng))
+         continue; // simulate detector inefficiency
+      parts.push_back(pj);
+   }
+}
 
-   // Nice label for filenames
-   const std::string labMin = trim_trailing_zeros(ptHatMin);
-   const std::string labMax = (ptHatMax > 0.0) ? trim_trailing_zeros(ptHatMax) : "-1";
-   const std::string outFile = out + "_pThat_" + labMin + "_" + labMax + ".root";
+// Cluster, pair back-to-back jets and count the perpendicular-cone background.
+// Appends one record per chosen dijet; returns false if there are fewer than two jets.
+// jetsOut (optional) receives all selected jets.
+bool findDijets(const std::vector<fastjet::PseudoJet> &parts, const fastjet::JetDefinition &jetDef,
+                const JetCuts &cuts, std::vector<DijetRecord> &out, std::vector<JetInfo> *jetsOut = nullptr)
+{
+   // Cluster
+   fastjet::ClusterSequence cs(parts, jetDef);
+   fastjet::Selector select_eta = fastjet::SelectorAbsEtaMax(cuts.jetEtaMax);
+   fastjet::Selector select_pt = fastjet::SelectorPtMin(cuts.jetPtMin);
+   fastjet::Selector select_both = select_pt && select_eta;
 
-   // --- Pythia setup ---
-   Pythia8::Pythia pythia8;
-   pythia8.readString("Beams:idA = 2212");
-   pythia8.readString("Beams:idB = 2212");
-   pythia8.readString("Beams:eCM = 200.");
+   auto all_jets = fastjet::sorted_by_pt(cs.inclusive_jets());
+   auto jets = select_both(all_jets);
+
+   // only charged tracks enter the clustering; user_index() is -1 if not set (ghosts), skip those
+   auto countCharged = [&](const fastjet::PseudoJet &j) {
+      int n = 0;
+      std::vector<fastjet::PseudoJet> consts = j.constituents();
+      for (const auto &c : consts) {
+         if (c.user_index() >= 0)
+            ++n;
+      }
+      return n;
+   };
+
+   if (jetsOut) {
+      jetsOut->clear();
+      for (const auto &j : jets)
+         jetsOut->push_back({j.pt(), j.eta(), j.phi(), countCharged(j)});
+   }
+
+   // Need at least two jets
+   if (jets.size() < 2)
+      return false;
 
-   pythia8.readString("HardQCD:all = on");
+   // back-to-back pairs, closest first, each jet used once
+   thread_local DijetPairing pairing;
+   const std::vector<DijetPairing::Pair> &chosenPairs = pairing.pair(jets, cuts.dPhiMin);
+
+   // charged particles in the perpendicular cones, via a grid so it scales to pileup multiplicities
+   thread_local EtaPhiGrid grid;
+   grid.build(parts, cuts.jetRadius, cuts.partPtMin, cuts.partEtaMax);
+
+   for (const auto &pair : chosenPairs) {
+
+      auto leadJet = jets[pair.lead];
+      auto subJet = jets[pair.sub];
+
+      DijetRecord r;
+      r.lead_n_charged = countCharged(leadJet);
+      r.sub_n_charged = countCharged(subJet);
+
+      r.lead_pt = leadJet.pt();
+      r.sub_pt = subJet.pt();
+      r.lead_eta = leadJet.eta();
+      r.sub_eta = subJet.eta();
+      r.lead_phi = leadJet.phi_std();
+      r.sub_phi = subJet.phi_std();
+      r.closeness = pair.closeness;
+
+      double phiA = deltaPhi(r.lead_phi, M_PI / 2);
+      double phiB = deltaPhi(r.lead_phi, -M_PI / 2);
+
+      r.background_mult_A = grid.countInCone(r.lead_eta, phiB);
+      r.background_mult_B = grid.countInCone(r.lead_eta, phiA);
+      r.weight = 1;
+      r.event_id = 0;
+      r.n_pileup = 0;
+      r.n_tracks = parts.size();
+      r.lead_pt_match = r.sub_pt_match = -1;
+      r.lead_n_charged_match = r.sub_n_charged_match = -1;
+      out.push_back(r);
+   }
+   return true;
+}
+
+// Fill the *_match fields of records[first..] with the closest jet in grid (built over jets).
+static void matchDijets(std::vector<DijetRecord> &records, size_t first, const EtaPhiGrid &grid,
+                        const std::vector<JetInfo> &jets)
+{
+   for (size_t k = first; k < records.size(); ++k) {
+      DijetRecord &r = records[k];
+      const int lead = grid.nearest(r.lead_eta, r.lead_phi);
+      const int sub = grid.nearest(r.sub_eta, r.sub_phi);
+      r.lead_pt_match = lead >= 0 ? jets[lead].pt() : -1;
+      r.lead_n_charged_match = lead >= 0 ? jets[lead].nCharged : -1;
+      r.sub_pt_match = sub >= 0 ? jets[sub].pt() : -1;
+      r.sub_n_charged_match = sub >= 0 ? jets[sub].nCharged : -1;
+   }
+}
+
+// Detector-level dijets from det and particle-level dijets from truth, clustered from the same event. Lead and
+// sub jet of every dijet are matched to the closest jet of the other level within cuts.matchRadius, looked up
+// in an eta-phi grid instead of all pairs. Returns whether there is a detector-level dijet.
+bool findMatchedDijets(const std::vector<fastjet::PseudoJet> &det, const std::vector<fastjet::PseudoJet> &truth,
+                       const fastjet::JetDefinition &jetDef, const JetCuts &cuts, std::vector<DijetRecord> &detOut,
+                       std::vector<DijetRecord> &truthOut)
+{
+   thread_local std::vector<JetInfo> detJets, truthJets;
+   thread_local EtaPhiGrid detGrid, truthGrid;
+   const size_t detFirst = detOut.size(), truthFirst = truthOut.size();
+   const bool hasDijet = findDijets(det, jetDef, cuts, detOut, &detJets);
+   findDijets(truth, jetDef, cuts, truthOut, &truthJets);
+
+   detGrid.build(detJets, cuts.matchRadius, 0, cuts.jetEtaMax);
+   truthGrid.build(truthJets, cuts.matchRadius, 0, cuts.jetEtaMax);
+   matchDijets(detOut, detFirst, truthGrid, truthJets);
+   matchDijets(truthOut, truthFirst, detGrid, detJets);
+   return hasDijet;
+}
+
+// Call f() once per hadron-level copy of the event just generated: the event itself, or, with
+// HadronLevel:all = off, nRehadronize hadronizations of the saved parton-level event. Copies whose hadronization
+// fails are dropped, so each copy weighs 1 / (number of calls), not 1 / nRehadronize.
+template <class F>
+void forEachHadronization(Pythia8::Pythia &pythia8, int nRehadronize, F &&f)
+{
+   if (nRehadronize == 1) {
+      f();
+      return;
+   }
+   const Pythia8::Event partonLevel = pythia8.event;
+   for (int k = 0; k < nRehadronize; ++k) {
+      if (k > 0)
+         pythia8.event = partonLevel;
+      if (!pythia8.forceHadronLevel())
+         continue;
+      f();
+   }
+}
+
+// Dijets of one hadron-level copy, kept until all copies of the event are known
+struct HadronCopy {
+   std::vector<DijetRecord> records, truthRecords;
+   int nPileup = 0;
+   bool hasDijet = false;
+};
+
+// lhefIn (optional): take the hard process from a Les Houches event file instead of HardQCD:all, so only showers,
+// MPI and hadronization run; the ptHat range then only labels the output. cmndFile (optional): settings read last,
+// e.g. a tune variation. False if cmndFile cannot be read.
+bool configurePythia(Pythia8::Pythia &pythia8, double ptHatMin, double ptHatMax, int seed, int nRehadronize,
+                     const std::string &lhefIn = "", const std::string &cmndFile = "")
+{
+   if (!lhefIn.empty()) {
+      pythia8.readString("Beams:frameType = 4");
+      pythia8.readString("Beams:LHEF = " + lhefIn);
+   } else {
+      pythia8.readString("Beams:idA = 2212");
+      pythia8.readString("Beams:idB = 2212");
+      pythia8.readString("Beams:eCM = 200.");
+
+      pythia8.readString("HardQCD:all = on");
+   }
 
    // mdcy(106, 1) = 0; // PI+ 211
    // mdcy(116, 1) = 0; // K+ 321
@@ -158,7 +486,7 @@ int main(int argc, char *argv[])
    //    "3334:mayDecay = off; 111:mayDecay = off; 221:mayDecay = off; 3212:mayDecay = off");
 
    // Phase space cuts
-   {
+   if (lhefIn.empty()) {
       std::ostringstream s1;
       s1 << "PhaseSpace:pTHatMin = " << ptHatMin;
       pythia8.readString(s1.str());
@@ -171,197 +499,924 @@ int main(int argc, char *argv[])
       }
    }
 
+   // Re-hadronization: stop at parton level in next() and hadronize by hand
+   if (nRehadronize > 1)
+      pythia8.readString("HadronLevel:all = off");
+
    // Random seed
    if (seed != 0) {
       pythia8.readString("Random:setSeed = on");
       pythia8.readString(("Random:seed = " + std::to_string(seed)).c_str());
    }
 
-   // Init
-   if (!pythia8.init()) {
-      std::cerr << "[error] PYTHIA init() failed.\n";
-      return 2;
+   if (!cmndFile.empty() && !pythia8.readFile(cmndFile)) {
+      std::cerr << "[error] cannot read settings file " << cmndFile << "\n";
+      return false;
    }
+   return true;
+}
 
-   // --- ROOT output ---
-   TFile *fout = new TFile(outFile.c_str(), "RECREATE");
-   TTree *t = new TTree("events", "dijet events");
+// Total cross section and error (mb) from the <init> block of a plain-text Les Houches file, as written by
+// --lhef-write (XSECUP / XERRUP in pb, one line per process). False if the block cannot be parsed.
+static bool readLhefSigma(const std::string &file, double &sigma, double &sigmaErr)
+{
+   std::ifstream in(file);
+   std::string line;
+   while (std::getline(in, line) && line.find("<init>") == std::string::npos) {
+   }
+   int nProcesses = 0;
+   if (!std::getline(in, line)) // beams, PDFs, weighting strategy, number of processes
+      return false;
+   {
+      std::istringstream beams(line);
+      double skip;
+      for (int i = 0; i < 9; ++i)
+         beams >> skip;
+      if (!(beams >> nProcesses) || nProcesses < 1)
+         return false;
+   }
+   double sum = 0, err2 = 0;
+   for (int i = 0; i < nProcesses; ++i) {
+      double xsec, xerr;
+      if (!std::getline(in, line) || !(std::istringstream(line) >> xsec >> xerr))
+         return false;
+      sum += xsec;
+      err2 += xerr * xerr;
+   }
+   sigma = sum * 1e-9; // pb -> mb
+   sigmaErr = std::sqrt(err2) * 1e-9;
+   return true;
+}
 
-   // Jet branches (store up to 10 dijets)
+// Minimum-bias overlay: Poisson(mu) pool entries added to every hadron-level copy before clustering
+struct Pileup {
+   const MinBiasPool *pool = nullptr;
+   double mu = 0;
 
-   int lead_n_charged, sub_n_charged;
-   double lead_pt, sub_pt, lead_eta, sub_eta, lead_phi, sub_phi, closeness, background_mult_A, background_mult_B;
+   int overlay(TRandom &rng, std::vector<fastjet::PseudoJet> &parts) const
+   {
+      return (pool && mu > 0) ? pool->overlay(rng, mu, parts) : 0;
+   }
+};
+
+// Fill the pool with nPool minimum-bias events (same beams, track cuts and efficiency as the signal), or load it
+// from cacheFile if that was made with the same settings.
+static bool prepareMinBiasPool(MinBiasPool &pool, int nPool, int seed, const JetCuts &cuts, TF1 &eff,
+                               const std::string &cacheFile)
+{
+   std::ostringstream settings;
+   settings << "SoftQCD:inelastic eCM=200 n=" << nPool << " seed=" << seed << " partPtMin=" << cuts.partPtMin
+            << " partEtaMax=" << cuts.partEtaMax << " eff=" << eff.GetParameter(0) << "," << eff.GetParameter(1)
+            << "," << eff.GetParameter(2);
+   const uint64_t key = MinBiasPool::key(settings.str());
+   if (!cacheFile.empty() && pool.load(cacheFile, key)) {
+      std::cout << "[pileup] loaded " << pool.size() << " minimum-bias events (" << pool.nTracks() << " tracks) from "
+                << cacheFile << "\n";
+      return true;
+   }
 
-   t->Branch("lead_pt", &lead_pt, "lead_pt/D");
-   t->Branch("sub_pt", &sub_pt, "sub_pt/D");
-   t->Branch("lead_eta", &lead_eta, "lead_eta/D");
-   t->Branch("sub_eta", &sub_eta, "sub_eta/D");
-   t->Branch("lead_phi", &lead_phi, "lead_phi/D");
-   t->Branch("sub_phi", &sub_phi, "sub_phi/D");
-   t->Branch("lead_n_charged", &lead_n_charged, "lead_n_charged/I");
-   t->Branch("sub_n_charged", &sub_n_charged, "sub_n_charged/I");
-   t->Branch("background_mult_A", &background_mult_A, "background_mult_A/D");
-   t->Branch("background_mult_B", &background_mult_B, "background_mult_B/D");
-   t->Branch("closeness", &closeness, "closeness/D");
+   Pythia8::Pythia mb;
+   mb.readString("Beams:idA = 2212");
+   mb.readString("Beams:idB = 2212");
+   mb.readString("Beams:eCM = 200.");
+   mb.readString("SoftQCD:inelastic = on");
+   mb.readString("Next:numberCount = 0");
+   mb.readString("Random:setSeed = on");
+   mb.readString("Random:seed = " + std::to_string(seed));
+   if (!mb.init()) {
+      std::cerr << "[error] PYTHIA init() failed for the minimum-bias pool.\n";
+      return false;
+   }
+   TRandom3 rng(seed);
+   std::vector<fastjet::PseudoJet> tracks;
+   pool.clear();
+   // events without tracks in acceptance are kept: they are part of the minimum-bias sample
+   const int kMaxConsecutiveFailures = 1000; // a broken tune or beam setup, not bad luck
+   int nFailures = 0;
+   while ((int)pool.size() < nPool) {
+      if (!mb.next()) {
+         if (++nFailures >= kMaxConsecutiveFailures) {
+            std::cerr << "[error] minimum-bias PYTHIA failed " << nFailures << " events in a row after " << pool.size()
+                      << " pool events, giving up.\n";
+            return false;
+         }
+         continue;
+      }
+      nFailures = 0;
+      selectTracks(mb.event, cuts, eff, rng, tracks);
+      pool.add(tracks);
+   }
+   std::cout << "[pileup] generated " << pool.size() << " minimum-bias events, " << double(pool.nTracks()) / nPool
+             << " tracks/event, sigma = " << mb.info.sigmaGen() << " mb\n";
+   if (!cacheFile.empty() && !pool.save(cacheFile, key))
+      std::cerr << "[error] could not write pileup pool cache " << cacheFile << "\n";
+   return true;
+}
 
-   fastjet::JetDefinition jetDef(fastjet::antikt_algorithm, jetRadius);
+// TTree buffer budget; 0 keeps the ROOT default
+struct TreeBuffers {
+   int basketSize = 0;           // bytes per branch basket
+   long long autoFlush = 0;      // flush baskets every N entries (N > 0) or every -N bytes (N < 0)
+   long long maxVirtualSize = 0; // bytes of baskets a tree may hold in memory
 
-   long long accepted = 0;
+   // call after the branches are booked
+   void apply(TTree *t) const
+   {
+      if (!t)
+         return;
+      if (basketSize > 0)
+         t->SetBasketSize("*", basketSize);
+      if (autoFlush != 0)
+         t->SetAutoFlush(autoFlush);
+      if (maxVirtualSize > 0)
+         t->SetMaxVirtualSize(maxVirtualSize);
+   }
+};
 
-   // Event loop
-   for (int iEvent = 0; iEvent < nEvents; ++iEvent) {
-      if (!pythia8.next())
-         continue;
+// events between two memory samples inside the event loop
+static const long long kMemorySampleEvents = 1000;
 
-      // Read pTHat
-      // double pthat = pythia8.info.pTHat();
+// "memory" (RSS) and "memory_heap" histograms in MB per checkpoint, written to the current directory.
+// The last "memory" bin is the peak RSS (VmHWM) of the process.
+static void writeMemory(const MemoryUsage::Tracker &mem)
+{
+   const auto &cps = mem.checkpoints();
+   TH1D *rss = new TH1D("memory", "RSS;checkpoint;MB", cps.size() + 1, 0, cps.size() + 1);
+   TH1D *heap = new TH1D("memory_heap", "heap in use;checkpoint;MB", cps.size(), 0, cps.size());
+   for (size_t i = 0; i < cps.size(); ++i) {
+      rss->GetXaxis()->SetBinLabel(i + 1, cps[i].label.c_str());
+      rss->SetBinContent(i + 1, cps[i].rssKb / 1024.);
+      heap->GetXaxis()->SetBinLabel(i + 1, cps[i].label.c_str());
+      heap->SetBinContent(i + 1, cps[i].heapKb / 1024.);
+   }
+   rss->GetXaxis()->SetBinLabel(cps.size() + 1, "peak");
+   rss->SetBinContent(cps.size() + 1, MemoryUsage::peakRssKb() / 1024.);
+   rss->Write();
+   heap->Write();
 
-      // Build input particles for jet finding
-      std::vector<fastjet::PseudoJet> parts;
-      parts.reserve(2000);
+   std::cout << "[memory] " << std::setw(16) << "checkpoint" << std::setw(12) << "RSS[MB]" << std::setw(12)
+             << "heap[MB]\n";
+   for (const auto &c : cps)
+      std::cout << "[memory] " << std::setw(16) << c.label << std::setw(12) << c.rssKb / 1024. << std::setw(12)
+                << c.heapKb / 1024. << "\n";
+   std::cout << "[memory] " << std::setw(16) << "peak" << std::setw(12) << MemoryUsage::peakRssKb() / 1024. << "\n";
+}
 
-      for (int i = 0; i < pythia8.event.size(); ++i) {
-         const auto &p = pythia8.event[i];
-         // final-state, visible (no neutrinos), basic kinematic filter
-         if (!p.isFinal() || !p.isVisible())
-            continue;
-         if (!p.isCharged())
-            continue; // charged only
-         // exclude neutrinos (should be covered by isVisible())
-         if (p.idAbs() == 12 || p.idAbs() == 14 || p.idAbs() == 16)
-            continue;
-         if (std::abs(p.eta()) > partEtaMax)
-            continue; // wide acceptance for clustering
-         if (p.pT() < partPtMin)
+static std::string shardName(const std::string &outFile, int iWorker)
+{
+   return outFile.substr(0, outFile.size() - 5) + "_shard" + std::to_string(iWorker) + ".root";
+}
+
+// Worker i of n numbers its events i, i + n, i + 2n, ..., so event ids stay unique in the merged file.
+// False (and reports) if an entry of the shard's "events" tree breaks that.
+static bool checkShardEventIds(TFile *f, const std::string &shard, int iShard, int nShards)
+{
+   TTree *t = (TTree *)f->Get("events");
+   if (!t)
+      return true;
+   Long64_t eventId;
+   t->SetBranchStatus("*", false);
+   t->SetBranchStatus("event_id", true);
+   t->SetBranchAddress("event_id", &eventId);
+   const Long64_t n = t->GetEntries();
+   for (Long64_t i = 0; i < n; ++i) {
+      t->GetEntry(i);
+      if (eventId % nShards != iShard) {
+         std::cerr << "[error] event_id " << eventId << " in " << shard << " is not of worker " << iShard << "\n";
+         return false;
+      }
+   }
+   return true;
+}
+
+// Merge the worker shards into outFile as if it came from a single job: nEvents and nAccepted are summed,
+// sigmaGen is the nEvents-weighted mean of the shards (hadd would add them up). The memory histograms are
+// summed too, an upper bound for the workers running side by side (shared pages count in every worker).
+// Event ids of different shards must be disjoint (checkShardEventIds).
+static bool mergeShards(const std::string &outFile, const std::vector<std::string> &shards,
+                        const std::vector<std::string> &trees)
+{
+   std::vector<std::unique_ptr<TChain>> chains;
+   for (const auto &tree : trees)
+      chains.emplace_back(new TChain(tree.c_str()));
+   long long nEvents = 0, nAccepted = 0;
+   double sigmaSum = 0, sigmaErr2 = 0;
+   const char *memoryNames[] = {"memory", "memory_heap"};
+   std::unique_ptr<TH1D> memory[2]; // sums by name; a shard may lack either
+   for (size_t iShard = 0; iShard < shards.size(); ++iShard) {
+      const std::string &shard = shards[iShard];
+      TFile *f = TFile::Open(shard.c_str());
+      TH1D *st = (f && !f->IsZombie()) ? (TH1D *)f->Get("stats") : nullptr;
+      if (!st || !checkShardEventIds(f, shard, iShard, shards.size())) {
+         if (!st)
+            std::cerr << "[error] cannot read stats from " << shard << "\n";
+         if (f)
+            f->Close();
+         delete f;
+         return false;
+      }
+      const double n = st->GetBinContent(1);
+      nEvents += (long long)n;
+      nAccepted += (long long)st->GetBinContent(2);
+      sigmaSum += n * st->GetBinContent(5);
+      sigmaErr2 += n * n * st->GetBinError(5) * st->GetBinError(5);
+      for (size_t k = 0; k < 2; ++k) {
+         TH1D *h = (TH1D *)f->Get(memoryNames[k]);
+         if (!h)
             continue;
-         if (!isAcceptedTrack(p.pT(), eff))
-            continue; // simulate detector inefficiency
-         fastjet::PseudoJet pj(p.px(), p.py(), p.pz(), p.e());
-         pj.set_user_index(i); // <— keep Pythia index to recover charge later
-         parts.push_back(pj);
+         if (!memory[k]) {
+            memory[k].reset((TH1D *)h->Clone());
+            memory[k]->SetDirectory(nullptr);
+         } else {
+            memory[k]->Add(h);
+         }
       }
+      f->Close();
+      delete f;
+      for (auto &chain : chains)
+         chain->Add(shard.c_str());
+   }
 
-      // Cluster
-      fastjet::ClusterSequence cs(parts, jetDef);
-      fastjet::Selector select_eta = fastjet::SelectorAbsEtaMax(jetEtaMax);
-      fastjet::Selector select_pt = fastjet::SelectorPtMin(jetPtMin);
-      fastjet::Selector select_both = select_pt && select_eta;
+   TFile *fout = new TFile(outFile.c_str(), "RECREATE");
+   for (auto &chain : chains)
+      chain->Merge(fout, 0, "fast keep");
+   fout->cd();
+   TH1D *stats = makeStats(nEvents, nAccepted, nEvents > 0 ? sigmaSum / nEvents : 0,
+                           nEvents > 0 ? std::sqrt(sigmaErr2) / nEvents : 0);
+   stats->Write();
+   for (auto &h : memory) {
+      if (h)
+         h->Write();
+   }
+   fout->Close();
+   delete fout;
 
-      auto all_jets = fastjet::sorted_by_pt(cs.inclusive_jets());
-      auto jets = select_both(all_jets);
-      // Need at least two jets
-      if (jets.size() < 2)
-         continue;
+   for (const auto &shard : shards)
+      std::remove(shard.c_str());
+   return true;
+}
 
-      accepted++;
+static void printWorkerSummary(const WorkerPool &pool, double initSeconds, long parentRssKb)
+{
+   double peakSum = 0, pssSum = 0, startupMax = 0;
+   std::cout << "[workers] " << std::setw(6) << "worker" << std::setw(12) << "events" << std::setw(12) << "startup[s]"
+             << std::setw(10) << "loop[s]" << std::setw(14) << "peakRSS[MB]" << std::setw(10) << "PSS[MB]\n";
+   for (const auto &r : pool.reports()) {
+      std::cout << "[workers] " << std::setw(6) << r.index << std::setw(12) << r.events << std::setw(12)
+                << r.startupSeconds << std::setw(10) << r.loopSeconds << std::setw(14) << r.peakRssKb / 1024.
+                << std::setw(10) << r.pssKb / 1024. << "\n";
+      peakSum += r.peakRssKb / 1024.;
+      pssSum += r.pssKb / 1024.;
+      startupMax = std::max(startupMax, r.startupSeconds);
+   }
+   const int n = pool.size();
+   std::cout << "[workers] startup: init once " << initSeconds << " s + fork " << startupMax << " s"
+             << "  vs  " << n << " independent processes: " << n << " x " << initSeconds << " s CPU\n"
+             << "[workers] memory: parent RSS after init " << parentRssKb / 1024. << " MB, sum of worker PSS "
+             << pssSum << " MB  vs  " << n << " independent processes: >= " << peakSum << " MB (sum of peak RSS)\n";
+}
 
-      std::vector<DijetPair> myPairs;
+// --- Pipelined mode: generator threads -> analysis threads -> one writer thread ---
 
-      for (size_t i = 0; i < jets.size(); ++i) {
-         double phi1 = jets[i].phi_std();
-         for (size_t j = i + 1; j < jets.size(); ++j) {
-            double phi2 = jets[j].phi_std();
-            double dphi12 = deltaPhi(phi1, phi2);
-            dphi12 = std::abs(dphi12); // make positive
+struct PipelineOptions {
+   int genThreads = 1;
+   int anaThreads = 1;
+   int queueSize = 256;
+   int imtThreads = 0; // ROOT implicit MT for basket compression in the writer, 0 = off
+};
 
-            if (dphi12 < dPhiMin)
-               continue;
-            // make ordered pair with leading first
-            int index_lead = i, index_sub = j;
-            if (jets[j].pt() > jets[i].pt())
-               std::swap(index_lead, index_sub);
+// compact track list of one hadron-level copy, as passed from generators to analysis
+struct Track {
+   float px, py, pz, e;
+};
 
-            DijetPair myPair;
-            myPair.lead = index_lead;
-            myPair.sub = index_sub;
-            myPair.closeness = M_PI - dphi12;
+struct GenEvent {
+   Long64_t event_id = 0;
+   std::vector<std::vector<Track>> copies; // nRehadronize copies (or one)
+   std::vector<int> nPileup;               // overlaid minimum-bias events per copy
+   std::vector<std::vector<Track>> truthCopies; // all charged particles, with --truth
+};
 
-            myPairs.push_back(myPair);
-         }
+struct AnaResult {
+   std::vector<DijetRecord> records;
+   std::vector<DijetRecord> truthRecords;
+};
+
+static int runPipeline(const PipelineOptions &po, double ptHatMin, double ptHatMax, int seed, int nRehadronize,
+                       const JetCuts &cuts, const TF1 &eff, const Pileup &pileup, int mixDepth, int mixPool,
+                       const StopCriteria &stop, const std::string &outFile, double progressInterval,
+                       const TreeBuffers &buffers, MemoryUsage::Tracker &mem, const std::string &cmndFile,
+                       double quickLookInterval)
+{
+   using Clock = std::chrono::steady_clock;
+   auto seconds = [](Clock::time_point a, Clock::time_point b) { return std::chrono::duration<double>(b - a).count(); };
+
+   ROOT::EnableThreadSafety();
+   if (po.imtThreads > 0)
+      ROOT::EnableImplicitMT(po.imtThreads);
+   fastjet::ClusterSequence::print_banner(); // once, before threads cluster
+
+   BoundedQueue<GenEvent> genQueue(po.queueSize);
+   BoundedQueue<AnaResult> outQueue(po.queueSize);
+   std::atomic<bool> genDone{false}, anaDone{false};
+   std::atomic<bool> failed{false};
+
+   // shared by all stages: generators ask next(), analysis counts accepted events, the writer counts pairs
+   RunControl run(stop, outFile + ".progress", progressInterval);
+   std::mutex runMutex;
+   // filled by the writer thread; sigmaGen is only known per generator at the end
+   QuickLook quick(outFile + ".quicklook", quickLookInterval, ptHatMin, ptHatMax);
+
+   const fastjet::JetDefinition jetDef(fastjet::antikt_algorithm, cuts.jetRadius);
+
+   // --- ROOT output, filled only by the writer thread ---
+   TFile *fout = new TFile(outFile.c_str(), "RECREATE");
+   TTree *t = new TTree("events", "dijet events");
+   const bool withTruth = cuts.matchRadius > 0;
+   DijetRecord rec, truthRec;
+   branchDijetRecord(t, rec, withTruth ? "truth" : nullptr);
+   TTree *truthTree = nullptr;
+   if (withTruth) {
+      truthTree = new TTree("truth", "particle-level dijets");
+      branchDijetRecord(truthTree, truthRec, "det");
+   }
+   MixedEvents mixed;
+   mixed.book(mixDepth, mixPool);
+   for (TTree *tree : {t, truthTree, mixed.tree})
+      buffers.apply(tree);
+   mem.sample("output booked");
+
+   // compact copies of the PseudoJets passed between the stages; user_index becomes the position
+   auto toTracks = [](const std::vector<fastjet::PseudoJet> &in) {
+      std::vector<Track> tracks;
+      tracks.reserve(in.size());
+      for (const auto &p : in)
+         tracks.push_back({float(p.px()), float(p.py()), float(p.pz()), float(p.E())});
+      return tracks;
+   };
+   auto fromTracks = [](const std::vector<Track> &tracks, std::vector<fastjet::PseudoJet> &out) {
+      out.clear();
+      for (size_t i = 0; i < tracks.size(); ++i) {
+         fastjet::PseudoJet pj(tracks[i].px, tracks[i].py, tracks[i].pz, tracks[i].e);
+         pj.set_user_index(i);
+         out.push_back(pj);
+      }
+   };
+
+   const int nGen = po.genThreads, nAna = po.anaThreads;
+   std::vector<long long> genEvents(nGen, 0);
+   std::vector<double> genSigma(nGen, 0), genSigmaErr(nGen, 0);
+   std::vector<double> busy(nGen + nAna + 1, 0); // seconds of work per thread: generators, analysis, writer
+   std::vector<std::unique_ptr<TF1>> effs;        // one efficiency function per generator
+   for (int g = 0; g < nGen; ++g)
+      effs.emplace_back(new TF1(eff));
+
+   auto generator = [&](int g) {
+      const long long base = (seed > 0) ? seed : 19780503;
+      const int genSeed = 1 + (base + 1000003LL * (g + 1)) % 899999999;
+      Pythia8::Pythia pythia8;
+      if (!configurePythia(pythia8, ptHatMin, ptHatMax, genSeed, nRehadronize, "", cmndFile) || !pythia8.init()) {
+         std::cerr << "[error] PYTHIA init() failed in generator " << g << ".\n";
+         failed = true;
+         return;
+      }
+      {
+         std::lock_guard<std::mutex> lock(runMutex);
+         mem.sample("pythia init");
       }
-      // sort pairs by closeness back-to-back
-      std::sort(myPairs.begin(), myPairs.end(),
-                [&](const DijetPair &A, const DijetPair &B) { return A.closeness <= B.closeness; });
-
-      std::vector<int> used(jets.size(), 0);
-      std::vector<DijetPair> chosenPairs;
-      chosenPairs.reserve(myPairs.size());
-
-      for (const auto &p : myPairs) {
-         if (!used[p.lead] && !used[p.sub]) {
-            chosenPairs.push_back(p);
-            used[p.lead] = used[p.sub] = 1;
+      TRandom3 rng(genSeed);
+      std::vector<fastjet::PseudoJet> parts, truthParts;
+
+      for (;;) {
+         Long64_t eventId;
+         {
+            std::lock_guard<std::mutex> lock(runMutex);
+            if (failed || !run.next())
+               break;
+            eventId = run.events() - 1;
+         }
+         ++genEvents[g];
+         const Clock::time_point t0 = Clock::now();
+         if (!pythia8.next()) {
+            busy[g] += seconds(t0, Clock::now());
+            continue;
          }
+         GenEvent ev;
+         ev.event_id = eventId;
+         forEachHadronization(pythia8, nRehadronize, [&]() {
+            selectTracks(pythia8.event, cuts, *effs[g], rng, parts, withTruth ? &truthParts : nullptr);
+            ev.nPileup.push_back(pileup.overlay(rng, parts));
+            ev.copies.push_back(toTracks(parts));
+            if (withTruth)
+               ev.truthCopies.push_back(toTracks(truthParts));
+         });
+         busy[g] += seconds(t0, Clock::now());
+         genQueue.push(ev);
       }
+      genSigma[g] = pythia8.info.sigmaGen();
+      genSigmaErr[g] = pythia8.info.sigmaErr();
+   };
 
-      auto countCharged = [&](const fastjet::PseudoJet &j) {
-         int n = 0;
-         std::vector<fastjet::PseudoJet> consts = j.constituents();
-         for (const auto &c : consts) {
-            int idx = c.user_index();
-            // Safety: user_index() is -1 if not set; skip those
-            if (idx >= 0 && idx < pythia8.event.size()) {
-               if (pythia8.event[idx].isCharged())
-                  ++n;
+   auto analysis = [&](int a) {
+      GenEvent ev;
+      std::vector<fastjet::PseudoJet> parts, truthParts;
+      while (genQueue.pop(ev, genDone)) {
+         const Clock::time_point t0 = Clock::now();
+         AnaResult res;
+         bool acceptedAny = false;
+         for (size_t iCopy = 0; iCopy < ev.copies.size(); ++iCopy) {
+            fromTracks(ev.copies[iCopy], parts);
+            const size_t first = res.records.size(), truthFirst = res.truthRecords.size();
+            bool hasDijet;
+            if (withTruth) {
+               fromTracks(ev.truthCopies[iCopy], truthParts);
+               hasDijet = findMatchedDijets(parts, truthParts, jetDef, cuts, res.records, res.truthRecords);
+            } else {
+               hasDijet = findDijets(parts, jetDef, cuts, res.records);
+            }
+            for (size_t k = truthFirst; k < res.truthRecords.size(); ++k) {
+               res.truthRecords[k].weight = 1.0 / ev.copies.size();
+               res.truthRecords[k].event_id = ev.event_id;
+            }
+            if (!hasDijet)
+               continue;
+            acceptedAny = true;
+            for (size_t k = first; k < res.records.size(); ++k) {
+               res.records[k].weight = 1.0 / ev.copies.size();
+               res.records[k].event_id = ev.event_id;
+               res.records[k].n_pileup = ev.nPileup[iCopy];
             }
          }
-         return n;
-      };
+         if (acceptedAny) {
+            std::lock_guard<std::mutex> lock(runMutex);
+            run.acceptEvent();
+         }
+         busy[nGen + a] += seconds(t0, Clock::now());
+         if (!res.records.empty() || !res.truthRecords.empty())
+            outQueue.push(res);
+      }
+   };
+
+   auto writer = [&]() {
+      AnaResult res;
+      long long nWritten = 0;
+      while (outQueue.pop(res, anaDone)) {
+         const Clock::time_point t0 = Clock::now();
+         for (const auto &r : res.records) {
+            rec = r;
+            t->Fill();
+            mixed.fill(r);
+            quick.fillPair(r.lead_pt, r.lead_n_charged, r.closeness, r.weight);
+         }
+         for (const auto &r : res.truthRecords) {
+            truthRec = r;
+            truthTree->Fill();
+         }
+         {
+            std::lock_guard<std::mutex> lock(runMutex);
+            for (const auto &r : res.records)
+               run.addPair(pairObservable(r, stop.observable));
+            if (++nWritten % kMemorySampleEvents == 0)
+               mem.sample("event loop");
+            quick.update(run.events(), run.accepted(), 0);
+         }
+         busy[nGen + nAna] += seconds(t0, Clock::now());
+      }
+   };
+
+   const Clock::time_point tStart = Clock::now();
+   std::thread writerThread(writer);
+   std::vector<std::thread> anaThreads, genThreads;
+   for (int a = 0; a < nAna; ++a)
+      anaThreads.emplace_back(analysis, a);
+   for (int g = 0; g < nGen; ++g)
+      genThreads.emplace_back(generator, g);
 
-      for (const auto &pair : chosenPairs) {
+   for (auto &th : genThreads)
+      th.join();
+   genDone = true;
+   for (auto &th : anaThreads)
+      th.join();
+   anaDone = true;
+   writerThread.join();
+   const double wall = seconds(tStart, Clock::now());
 
-         auto leadJet = jets[pair.lead];
-         auto subJet = jets[pair.sub];
+   run.finish();
+   const long long nGenerated = run.events();
+   const long long accepted = run.accepted();
+
+   // Cross sections (mb): nEvents-weighted mean over the generators
+   double sigmaSum = 0, sigmaErr2 = 0;
+   for (int g = 0; g < nGen; ++g) {
+      sigmaSum += genEvents[g] * genSigma[g];
+      sigmaErr2 += double(genEvents[g]) * genEvents[g] * genSigmaErr[g] * genSigmaErr[g];
+   }
+   const double sigmaGen = nGenerated > 0 ? sigmaSum / nGenerated : 0;
+   const double sigmaErr = nGenerated > 0 ? std::sqrt(sigmaErr2) / nGenerated : 0;
+
+   fout->cd();
+   makeStats(nGenerated, accepted, sigmaGen, sigmaErr);
+   quick.finish(nGenerated, accepted, sigmaGen);
+   mem.sample("event loop");
+   fout->Write();
+   mem.sample("write");
+   writeMemory(mem);
+   fout->Close();
+   delete fout;
+
+   // stage utilisation: busy time / (threads x wall time); the busiest stage is the bottleneck
+   auto utilisation = [&](int first, int n) {
+      double sum = 0;
+      for (int i = first; i < first + n; ++i)
+         sum += busy[i];
+      return wall > 0 ? sum / (n * wall) : 0.;
+   };
+   std::cout << "[pipeline] " << nGen << " generator / " << nAna << " analysis / 1 writer thread(s), wall " << wall
+             << " s, " << (wall > 0 ? nGenerated / wall : 0.) << " events/s\n"
+             << "[pipeline] busy: generators " << 100 * utilisation(0, nGen) << "%, analysis "
+             << 100 * utilisation(nGen, nAna) << "%, writer " << 100 * utilisation(nGen + nAna, 1) << "%\n";
+   genQueue.printStats("gen->analysis");
+   outQueue.printStats("analysis->writer");
+
+   std::cout << "[done] Wrote " << outFile << "\n"
+             << "       stopped by = " << run.stopReason() << " after " << run.elapsed() << " s\n"
+             << "       N_accepted = " << accepted << "\n"
+             << "       sigmaGen   = " << sigmaGen << " mb  (± " << sigmaErr << ")\n";
+   std::cout << "Accepted dijet-like events: " << accepted << " / " << nGenerated << std::endl;
+   return failed ? 2 : 0;
+}
 
-         lead_n_charged = countCharged(leadJet);
-         sub_n_charged = countCharged(subJet);
+int main(int argc, char *argv[])
+{
+   const auto tProgramStart = std::chrono::steady_clock::now();
+   gRandom->SetSeed(0); // use random seed based on machine time
+   CmdOptions opts(argc, argv);
+   const std::vector<std::string> &args = opts.positional();
+   if (args.size() < 2) {
+      std::cerr << "Usage: " << argv[0]
+                << " pTHatMin pTHatMax|inf [nEvents=50000] [SEED=12345]"
+                   " [OUTPREFIX=pp200_HardQCD] [options]\n"
+                   "Options (stop at whichever comes first; nEvents = 0 means no event limit):\n"
+                   "  --max-time=SEC            wall-clock budget for the event loop\n"
+                   "  --target-pairs=N          number of accepted dijet pairs\n"
+                   "  --target-precision=REL    relative error on the mean of --observable\n"
+                   "  --observable=NAME         lead_n_charged|sub_n_charged|lead_pt|background_mult"
+                   " [lead_n_charged]\n"
+                   "  --progress-interval=SEC   update OUTFILE.progress every SEC seconds, 0 = off [60]\n"
+                   "  --quicklook-interval=SEC  write quick-look histograms to OUTFILE.quicklook every SEC seconds,"
+                   " 0 = off [60]\n"
+                   "  --rehadronize=K           hadronize every parton-level event K times, weight 1/K [1]\n"
+                   "  --workers=N               fork N workers after init, one shard each, merged at the end [1]\n"
+                   "  --pipeline                generator -> analysis -> writer threads joined by lock-free queues\n"
+                   "  --gen-threads=G           pipeline generator threads, one Pythia instance each [1]\n"
+                   "  --ana-threads=A           pipeline clustering/pairing threads [1]\n"
+                   "  --queue-size=Q            capacity of each pipeline queue [256]\n"
+                   "  --imt=N                   ROOT implicit MT threads for the writer's basket compression [0]\n"
+                   "  --pileup-mu=MU            overlay Poisson(MU) minimum-bias events on every event [0]\n"
+                   "  --pileup-pool=N           minimum-bias events in the pool, reused with random phi [2000]\n"
+                   "  --pileup-cache=FILE       load / save the overlay pool\n"
+                   "  --mix-depth=D             pair cone A with cone B of D earlier dijets of the same class,"
+                   " tree \"mixed\" [0]\n"
+                   "  --mix-pool=P              dijets kept per lead-pT / multiplicity class, >= D [D]\n"
+                   "  --truth                   also cluster all charged particles (before efficiency), tree"
+                   " \"truth\", jets matched both ways\n"
+                   "  --basket-size=BYTES       TTree basket size per branch [ROOT default]\n"
+                   "  --autoflush=N             flush baskets every N entries, or every -N bytes [ROOT default]\n"
+                   "  --max-virtual-size=BYTES  basket memory a TTree may hold before dropping baskets"
+                   " [ROOT default]\n"
+                   "  --lhef-write=FILE         also write the hard-process events and sigmaGen to a Les Houches file\n"
+                   "  --lhef-read=FILE          hard process from FILE, only showers/MPI/hadronization are run;"
+                   " ends at the end of FILE\n"
+                   "  --cmnd=FILE               PYTHIA settings read after the defaults (tune variations)\n";
+      return 1;
+   }
 
-         lead_pt = leadJet.pt();
-         sub_pt = subJet.pt();
-         lead_eta = leadJet.eta();
-         sub_eta = subJet.eta();
-         lead_phi = leadJet.phi_std();
-         sub_phi = subJet.phi_std();
-         closeness = pair.closeness;
+   TF1 eff("eff", "[0]*(1-exp(-pow(x/[1],[2])))", 0, 30);
+   eff.SetParameters(0.88, 0.25, 1.2); // eff_max, p0, n
 
-         double phiA = deltaPhi(lead_phi, M_PI / 2);
-         double phiB = deltaPhi(lead_phi, -M_PI / 2);
+   // Required: pTHatMin
+   const double ptHatMin = opts.positional(0, 0);
 
-         background_mult_A = countInCone(parts, lead_eta, phiB, jetRadius, partPtMin, partEtaMax);
-         background_mult_B = countInCone(parts, lead_eta, phiA, jetRadius, partPtMin, partEtaMax);
+   // Required: pTHatMax (can be "inf" or negative for open upper bound)
+   double ptHatMax;
+   std::string s = args[1];
+   if (s == "inf" || s == "Inf" || s == "INF") {
+      ptHatMax = -1.0;
+   } else {
+      ptHatMax = opts.positional(1, -1);
+   }
+   int nEvents = (int)opts.positional(2, 50000);
+   int seed = (int)opts.positional(3, 12345);
+   if (!opts.checkValues())
+      return 1;
 
-         t->Fill();
+   if (ptHatMax > 0.0 && ptHatMax < ptHatMin) {
+      std::cerr << "[error] pTHatMax < pTHatMin\n";
+      return 1;
+   }
+
+   std::string out = (args.size() > 4) ? args[4] : "pp200";
+
+   StopCriteria stop;
+   stop.maxEvents = std::max(nEvents, 0);
+   stop.maxSeconds = opts.get("max-time", 0.0);
+   stop.targetPairs = (long long)opts.get("target-pairs", 0.0);
+   stop.targetPrecision = opts.get("target-precision", 0.0);
+   stop.observable = opts.get("observable", stop.observable);
+   const double progressInterval = opts.get("progress-interval", 60.0);
+   const double quickLookInterval = opts.get("quicklook-interval", 60.0);
+   const int nRehadronize = (int)opts.get("rehadronize", 1.0);
+   const int nWorkers = (int)opts.get("workers", 1.0);
+   const bool pipeline = opts.get("pipeline", 0.0) != 0;
+   PipelineOptions po;
+   po.genThreads = (int)opts.get("gen-threads", double(po.genThreads));
+   po.anaThreads = (int)opts.get("ana-threads", double(po.anaThreads));
+   po.queueSize = (int)opts.get("queue-size", double(po.queueSize));
+   po.imtThreads = (int)opts.get("imt", double(po.imtThreads));
+   const double pileupMu = opts.get("pileup-mu", 0.0);
+   const int pileupPoolSize = (int)opts.get("pileup-pool", 2000.0);
+   const std::string pileupCache = opts.get("pileup-cache", std::string());
+   const int mixDepth = (int)opts.get("mix-depth", 0.0);
+   const int mixPool = (int)opts.get("mix-pool", double(mixDepth));
+   const bool withTruth = opts.get("truth", 0.0) != 0;
+   TreeBuffers buffers;
+   buffers.basketSize = (int)opts.get("basket-size", 0.0);
+   buffers.autoFlush = (long long)opts.get("autoflush", 0.0);
+   buffers.maxVirtualSize = (long long)opts.get("max-virtual-size", 0.0);
+   const std::string lhefOut = opts.get("lhef-write", std::string());
+   const std::string lhefIn = opts.get("lhef-read", std::string());
+   const std::string cmndFile = opts.get("cmnd", std::string());
+   if (!opts.checkUnused() || !opts.checkValues())
+      return 1;
+   if (nRehadronize < 1) {
+      std::cerr << "[error] --rehadronize must be >= 1\n";
+      return 1;
+   }
+   if (nWorkers < 1 || (nEvents > 0 && nEvents < nWorkers)) {
+      std::cerr << "[error] --workers must be >= 1 and <= nEvents\n";
+      return 1;
+   }
+   if (pipeline && (nWorkers > 1 || po.genThreads < 1 || po.anaThreads < 1 || po.queueSize < 2)) {
+      std::cerr << "[error] --pipeline needs >= 1 generator and analysis thread, --queue-size >= 2, and no --workers\n";
+      return 1;
+   }
+   if (pileupMu < 0 || (pileupMu > 0 && pileupPoolSize < 1)) {
+      std::cerr << "[error] --pileup-mu must be >= 0 and --pileup-pool >= 1\n";
+      return 1;
+   }
+   if (mixDepth < 0 || mixPool < mixDepth) {
+      std::cerr << "[error] --mix-depth must be >= 0 and --mix-pool >= --mix-depth\n";
+      return 1;
+   }
+   if (buffers.basketSize < 0 || buffers.maxVirtualSize < 0) {
+      std::cerr << "[error] --basket-size and --max-virtual-size must be >= 0\n";
+      return 1;
+   }
+   if ((!lhefOut.empty() || !lhefIn.empty()) && (pipeline || nWorkers > 1 || (!lhefOut.empty() && !lhefIn.empty()))) {
+      std::cerr << "[error] --lhef-write / --lhef-read work in a single process, one of them at a time\n";
+      return 1;
+   }
+   if (!stop.bounded() && lhefIn.empty()) {
+      std::cerr << "[error] nEvents = 0 needs --max-time, --target-pairs, --target-precision or --lhef-read\n";
+      return 1;
+   }
+   const std::vector<std::string> observables = {"lead_n_charged", "sub_n_charged", "lead_pt", "background_mult"};
+   if (std::find(observables.begin(), observables.end(), stop.observable) == observables.end()) {
+      std::cerr << "[error] unknown --observable " << stop.observable << "\n";
+      return 1;
+   }
+
+   // jet parameter
+   const double jetRadius = 0.4;
+   const double jetEtaMax = 1.0 - jetRadius;
+   const double dPhiMin = 0.75 * M_PI; // back-to-back requirement
+   const double jetPtMin = 3.0;
+   // particle parameters
+   const double partPtMin = 0.15;
+   const double partEtaMax = 1.0;
+   // particle <-> detector level matching
+   const double matchRadius = 0.3;
+
+   // Nice label for filenames
+   const std::string labMin = trim_trailing_zeros(ptHatMin);
+   const std::string labMax = (ptHatMax > 0.0) ? trim_trailing_zeros(ptHatMax) : "-1";
+   const std::string outFile = out + "_pThat_" + labMin + "_" + labMax + ".root";
+
+   const JetCuts cuts{jetRadius, jetEtaMax, dPhiMin, jetPtMin, partPtMin, partEtaMax, withTruth ? matchRadius : 0};
+   std::vector<std::string> outputTrees = {"events"};
+   if (mixDepth > 0)
+      outputTrees.push_back("mixed");
+   if (withTruth)
+      outputTrees.push_back("truth");
+
+   // memory footprint at the main stages, written as histograms "memory" / "memory_heap"
+   MemoryUsage::Tracker mem;
+   mem.sample("start");
+
+   // minimum-bias pool, built before any fork / thread so workers share it
+   MinBiasPool minBiasPool;
+   Pileup pileup;
+   if (pileupMu > 0) {
+      const int poolSeed = 1 + (std::abs(seed) + 7919) % 899999999;
+      if (!prepareMinBiasPool(minBiasPool, pileupPoolSize, poolSeed, cuts, eff, pileupCache))
+         return 2;
+      pileup.pool = &minBiasPool;
+      pileup.mu = pileupMu;
+      mem.sample("pileup pool");
+   }
+
+   if (pipeline)
+      return runPipeline(po, ptHatMin, ptHatMax, seed, nRehadronize, cuts, eff, pileup, mixDepth, mixPool, stop,
+                         outFile, progressInterval, buffers, mem, cmndFile, quickLookInterval);
+
+   // --- Pythia setup ---
+   Pythia8::Pythia pythia8;
+   if (!configurePythia(pythia8, ptHatMin, ptHatMax, seed, nRehadronize, lhefIn, cmndFile))
+      return 1;
+
+   // Init
+   if (!pythia8.init()) {
+      std::cerr << "[error] PYTHIA init() failed.\n";
+      return 2;
+   }
+   mem.sample("pythia init");
+
+   // hard-process events (before showers) streamed to a Les Houches file, sigmaGen written into its init block
+   std::unique_ptr<Pythia8::LHAupFromPYTHIA8> lhefWriter;
+   if (!lhefOut.empty()) {
+      lhefWriter.reset(new Pythia8::LHAupFromPYTHIA8(&pythia8.process, &pythia8.info));
+      if (!lhefWriter->openLHEF(lhefOut) || !lhefWriter->setInit() || !lhefWriter->initLHEF()) {
+         std::cerr << "[error] cannot write Les Houches file " << lhefOut << "\n";
+         return 2;
+      }
+   }
+
+   // --- Worker pool: fork after init, each worker writes its own shard ---
+   std::unique_ptr<WorkerPool> pool;
+   WorkerReport report;
+   std::string shardFile = outFile;
+   int eventIdOffset = 0, eventIdStride = 1; // worker i of n: ids i, i + n, ...
+   if (nWorkers > 1) {
+      const double initSeconds =
+         std::chrono::duration<double>(std::chrono::steady_clock::now() - tProgramStart).count();
+      const long parentRssKb = MemoryUsage::rssKb();
+      std::vector<std::string> shards;
+      for (int i = 0; i < nWorkers; ++i)
+         shards.push_back(shardName(outFile, i));
+
+      pool.reset(new WorkerPool(nWorkers));
+      const auto tFork = std::chrono::steady_clock::now();
+      const int iWorker = pool->fork();
+      if (iWorker < 0) {
+         // parent: all workers are done
+         if (!pool->ok() || !mergeShards(outFile, shards, outputTrees)) {
+            std::cerr << "[error] worker pool failed, shards left in place\n";
+            return 3;
+         }
+         printWorkerSummary(*pool, initSeconds, parentRssKb);
+         std::cout << "[done] Merged " << nWorkers << " shards into " << outFile << std::endl;
+         return 0;
+      }
+
+      // worker: own random streams, own share of the stop criteria
+      const long long base = (seed > 0) ? seed : 19780503;
+      const int workerSeed = 1 + (base + 1000003LL * (iWorker + 1)) % 899999999;
+      pythia8.rndm.init(workerSeed);
+      gRandom->SetSeed(workerSeed);
+      stop.maxEvents = stop.maxEvents / nWorkers + (iWorker < stop.maxEvents % nWorkers ? 1 : 0);
+      stop.targetPairs = stop.targetPairs / nWorkers + (iWorker < stop.targetPairs % nWorkers ? 1 : 0);
+      stop.targetPrecision *= std::sqrt(double(nWorkers)); // errors of the shards combine as 1/sqrt(N)
+      shardFile = shards[iWorker];
+      eventIdOffset = iWorker;
+      eventIdStride = nWorkers;
+      report.index = iWorker;
+      report.startupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tFork).count();
+   }
+
+   // --- ROOT output ---
+   TFile *fout = new TFile(shardFile.c_str(), "RECREATE");
+   TTree *t = new TTree("events", "dijet events");
+
+   // Jet branches (store up to 10 dijets)
+   DijetRecord rec, truthRec;
+   branchDijetRecord(t, rec, withTruth ? "truth" : nullptr);
+   TTree *truthTree = nullptr;
+   if (withTruth) {
+      truthTree = new TTree("truth", "particle-level dijets");
+      branchDijetRecord(truthTree, truthRec, "det");
+   }
+   MixedEvents mixed;
+   mixed.book(mixDepth, mixPool);
+   for (TTree *tree : {t, truthTree, mixed.tree})
+      buffers.apply(tree);
+   mem.sample("output booked");
+
+   fastjet::JetDefinition jetDef(fastjet::antikt_algorithm, jetRadius);
+
+   RunControl run(stop, shardFile + ".progress", progressInterval);
+   QuickLook quick(shardFile + ".quicklook", quickLookInterval, ptHatMin, ptHatMax);
+
+   std::vector<fastjet::PseudoJet> parts, truthParts;
+   parts.reserve(2000);
+   std::vector<HadronCopy> copies;
+
+   // Event loop
+   while (run.next()) {
+      if (!pythia8.next()) {
+         if (!lhefIn.empty() && pythia8.info.atEndOfFile())
+            run.endOfInput();
+         continue;
       }
+      const Long64_t eventId = (run.events() - 1) * eventIdStride + eventIdOffset;
+      if (lhefWriter) {
+         lhefWriter->setEvent();
+         lhefWriter->eventLHEF(false);
+      }
+
+      // each hadron-level copy carries weight 1/(copies that hadronized) and the shared event id
+      int nCopies = 0;
+      forEachHadronization(pythia8, nRehadronize, [&]() {
+         if (int(copies.size()) <= nCopies)
+            copies.emplace_back();
+         HadronCopy &copy = copies[nCopies++];
+         selectTracks(pythia8.event, cuts, eff, *gRandom, parts, withTruth ? &truthParts : nullptr);
+         copy.nPileup = pileup.overlay(*gRandom, parts);
+         copy.records.clear();
+         copy.truthRecords.clear();
+         copy.hasDijet = withTruth
+                            ? findMatchedDijets(parts, truthParts, jetDef, cuts, copy.records, copy.truthRecords)
+                            : findDijets(parts, jetDef, cuts, copy.records);
+      });
+      bool acceptedAny = false;
+      for (int k = 0; k < nCopies; ++k) {
+         const HadronCopy &copy = copies[k];
+         for (const auto &r : copy.truthRecords) {
+            truthRec = r;
+            truthRec.weight = 1.0 / nCopies;
+            truthRec.event_id = eventId;
+            truthTree->Fill();
+         }
+         if (!copy.hasDijet)
+            continue;
+         acceptedAny = true;
+         for (const auto &r : copy.records) {
+            rec = r;
+            rec.weight = 1.0 / nCopies;
+            rec.event_id = eventId;
+            rec.n_pileup = copy.nPileup;
+            t->Fill();
+            mixed.fill(rec);
+            run.addPair(pairObservable(rec, stop.observable));
+            quick.fillPair(rec.lead_pt, rec.lead_n_charged, rec.closeness, rec.weight);
+         }
+      }
+      if (acceptedAny)
+         run.acceptEvent();
+      quick.update(run.events(), run.accepted(), pythia8.info.sigmaGen());
+      if (run.events() % kMemorySampleEvents == 0)
+         mem.sample("event loop");
    }
+   mem.sample("event loop");
 
-   // Cross sections (mb)
-   const double sigmaGen = pythia8.info.sigmaGen();
-   const double sigmaErr = pythia8.info.sigmaErr();
+   run.finish();
+   const long long nGenerated = run.events(); // events actually tried: sigmaGen / nGenerated is the per-event weight
+   const long long accepted = run.accepted();
 
-   TH1D *stats = new TH1D("stats", "stats", 6, 0, 6);
-   vector<TString> statNames = {"nEvents", "nAccepted", "ptHatMin", "ptHatMax", "sigmaGen_mb", "sigmaErr_mb"};
-   for (size_t i = 0; i < statNames.size(); ++i)
-      stats->GetXaxis()->SetBinLabel(i + 1, statNames[i]);
+   // Cross sections (mb); events read from a Les Houches file carry the cross section of the job that wrote it
+   double sigmaGen = pythia8.info.sigmaGen();
+   double sigmaErr = pythia8.info.sigmaErr();
+   if (!lhefIn.empty() && !readLhefSigma(lhefIn, sigmaGen, sigmaErr))
+      std::cerr << "[warning] no cross section in " << lhefIn << ", using the PYTHIA estimate\n";
+   if (lhefWriter) {
+      lhefWriter->updateSigma();
+      lhefWriter->closeLHEF(true); // rewrites the init block with the final sigmaGen
+   }
 
-   stats->SetBinContent(1, nEvents);
-   stats->SetBinContent(2, accepted);
-   // stats->SetBinContent(3, ptHatMin);
-   // stats->SetBinContent(4, ptHatMax);
-   stats->SetBinContent(5, sigmaGen);
-   stats->SetBinError(5, sigmaErr);
-   // stats->SetBinContent(6, sigmaErr);
+   makeStats(nGenerated, accepted, sigmaGen, sigmaErr);
+   quick.finish(nGenerated, accepted, sigmaGen);
 
    // Print and record
-   std::cout << "[done] Wrote " << outFile << "\n"
+   std::cout << "[done] Wrote " << shardFile << "\n"
+             << "       stopped by = " << run.stopReason() << " after " << run.elapsed() << " s\n"
              << "       N_accepted = " << accepted << "\n"
              << "       sigmaGen   = " << sigmaGen << " mb  (± " << sigmaErr << ")\n";
 
    pythia8.stat();
 
    fout->Write();
+   mem.sample("write");
+   writeMemory(mem);
    fout->Close();
    delete fout;
 
-   std::cout << "Accepted dijet-like events: " << accepted << " / " << nEvents << std::endl;
+   std::cout << "Accepted dijet-like events: " << accepted << " / " << nGenerated << std::endl;
+
+   if (pool) {
+      report.peakRssKb = MemoryUsage::peakRssKb();
+      report.pssKb = MemoryUsage::pssKb();
+      report.loopSeconds = run.elapsed();
+      report.events = nGenerated;
+      pool->report(report);
+   }
    return 0;
 }
@@ -51,9 +51,12 @@ mkdir -p "$OUTDIR"
 PREFIX="pp200_"$CLUSTER"_"$PROC
 
 SEED="0"
+# Finish the event loop well before the 3 h limit in condor_control.sh;
+# stats (nEvents, sigmaGen) are written for whatever was generated.
+MAXTIME="${MAXTIME:-9900}"
 # Run the job
 # Note: we bind /gpfs01 because your inputs/outputs live there.
 "$APPTAINER_BIN" exec -B /gpfs01 "$IMG" \
-  "$EXECUTABLE" "$PTMIN" "$PTMAX" "$NEVT" "$SEED" $OUTDIR/$PREFIX
+  "$EXECUTABLE" "$PTMIN" "$PTMAX" "$NEVT" "$SEED" $OUTDIR/$PREFIX --max-time=$MAXTIME
 
 echo "[`date`] Finished."
@@ -54,5 +54,5 @@ echo "Merging TTrees done."
 echo "Running anaTrees..."
 cd $WORKDIR
 
-apptainer exec -B /gpfs01 rivet-pythia.sif\
- /usr/local/root/bin/root -l -b -q  anaTrees/anaTrees.cpp+
+apptainer exec -B /gpfs01 rivet-pythia.sif make anaTrees/anaTrees
+apptainer exec -B /gpfs01 rivet-pythia.sif ./anaTrees/anaTrees --threads=8